@@ -0,0 +1,72 @@
+#include "include/arena.hpp"
+
+#include <algorithm>
+
+JklArena::JklArena(size_t blockSize) : blockSize(std::max(blockSize, (size_t)256)) {}
+
+JklArena::~JklArena(void) {
+    for (Block& block : blocks)
+        delete[] block.data;
+}
+
+void* JklArena::allocateSlow(size_t bytes, size_t alignment) {
+    // blocks past the current one are left over from before a rewind, reuse them first
+    while (current + 1 < blocks.size()) {
+        current++;
+        offset = 0;
+        size_t start = (reinterpret_cast<uintptr_t>(blocks[current].data) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        start -= reinterpret_cast<uintptr_t>(blocks[current].data);
+        if (start + bytes <= blocks[current].size) {
+            offset = start + bytes;
+            return blocks[current].data + start;
+        }
+    }
+    // each new block doubles, so a frame needs few of them even before the first reset merges them
+    size_t size = blocks.empty() ? blockSize : blocks.back().size * 2;
+    size = std::max(size, bytes + alignment);
+    Block block = {new char[size], size};
+    blockAllocations++;
+    blocks.push_back(block);
+    current = blocks.size() - 1;
+    size_t start = (reinterpret_cast<uintptr_t>(block.data) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    start -= reinterpret_cast<uintptr_t>(block.data);
+    offset = start + bytes;
+    return block.data + start;
+}
+
+size_t JklArena::capacity(void) const {
+    size_t total = 0;
+    for (const Block& block : blocks)
+        total += block.size;
+    return total;
+}
+
+size_t JklArena::used(void) const {
+    size_t total = offset;
+    for (size_t i = 0; i < current && i < blocks.size(); i++)
+        total += blocks[i].size;
+    return total;
+}
+
+void JklArena::reset(void) {
+    peak = std::max(peak, used());
+    if (blocks.size() > 1) {
+        size_t total = capacity();
+        for (Block& block : blocks)
+            delete[] block.data;
+        blocks.clear();
+        blocks.push_back({new char[total], total});
+        blockAllocations++;
+    }
+    current = 0;
+    offset = 0;
+}
+
+JklArena& jklFrameArena(void) {
+    static thread_local JklArena arena;
+    return arena;
+}
+
+void jklarenaResetFrame(void) {
+    jklFrameArena().reset();
+}
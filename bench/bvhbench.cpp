@@ -0,0 +1,137 @@
+// bvhbench : JklBvh build, refit and query cost against testing every object
+//
+//   bvhbench [queries]
+//
+// Scatters 10k and 100k boxes of varying size through a 2km cube and times the SAH build,
+// a refit after moving a tenth of them, and frustum, sphere, box and ray queries. Frustum
+// queries are compared with a brute force loop over all boxes to check both agree.
+
+#include "../include/bvh.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static glm::mat4 viewProjection(const glm::vec3& eye, const glm::vec3& forward) {
+    return glm::perspective(1.0f, 16.0f / 9.0f, 0.1f, 800.0f) * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static void run(int objects, int queries) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> size(0.5f, 8.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<JklAabb> boxes(objects);
+    for (auto& box : boxes) {
+        glm::vec3 c(position(rng), position(rng), position(rng));
+        glm::vec3 e(size(rng), size(rng), size(rng));
+        box.expand(c - e);
+        box.expand(c + e);
+    }
+
+    JklBvh bvh;
+    auto start = std::chrono::steady_clock::now();
+    bvh.build(boxes);
+    double buildMs = millisecondsSince(start);
+
+    for (int i = 0; i < objects; i += 10) {
+        glm::vec3 offset(unit(rng), unit(rng), unit(rng));
+        JklAabb moved = boxes[i];
+        moved.min += offset;
+        moved.max += offset;
+        boxes[i] = moved;
+        bvh.update(i, moved);
+    }
+    start = std::chrono::steady_clock::now();
+    bvh.refit();
+    double refitMs = millisecondsSince(start);
+
+    std::vector<JklFrustum> frustums;
+    std::vector<glm::vec3> eyes;
+    for (int q = 0; q < queries; q++) {
+        glm::vec3 eye(position(rng), position(rng), position(rng));
+        glm::vec3 forward = glm::normalize(glm::vec3(unit(rng), unit(rng) * 0.3f, unit(rng)) + glm::vec3(0.001f, 0.0f, 0.0f));
+        frustums.push_back(JklFrustum(viewProjection(eye, forward)));
+        eyes.push_back(eye);
+    }
+
+    std::vector<int> out;
+    size_t found = 0;
+    start = std::chrono::steady_clock::now();
+    for (auto& frustum : frustums) {
+        out.clear();
+        bvh.queryFrustum(frustum, out);
+        found += out.size();
+    }
+    double frustumMs = millisecondsSince(start) / queries;
+
+    size_t bruteFound = 0;
+    start = std::chrono::steady_clock::now();
+    for (auto& frustum : frustums)
+        for (auto& box : boxes)
+            bruteFound += frustum.testAabb(box) ? 1 : 0;
+    double bruteMs = millisecondsSince(start) / queries;
+
+    start = std::chrono::steady_clock::now();
+    size_t sphereFound = 0;
+    for (auto& eye : eyes) {
+        out.clear();
+        JklSphere sphere;
+        sphere.center = eye;
+        sphere.radius = 50.0f;
+        bvh.querySphere(sphere, out);
+        sphereFound += out.size();
+    }
+    double sphereMs = millisecondsSince(start) / queries;
+
+    start = std::chrono::steady_clock::now();
+    size_t boxFound = 0;
+    for (auto& eye : eyes) {
+        out.clear();
+        JklAabb box;
+        box.expand(eye - glm::vec3(50.0f));
+        box.expand(eye + glm::vec3(50.0f));
+        bvh.queryAabb(box, out);
+        boxFound += out.size();
+    }
+    double boxMs = millisecondsSince(start) / queries;
+
+    start = std::chrono::steady_clock::now();
+    int rayHits = 0;
+    for (auto& eye : eyes) {
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.001f, 0.0f, 0.0f));
+        float distance = 4000.0f;
+        if (bvh.raycast(eye, direction, distance) >= 0)
+            rayHits++;
+    }
+    double rayMs = millisecondsSince(start) / queries;
+
+    std::cout << objects << " objects, " << bvh.nodeCount() << " nodes" << std::endl
+              << "  build    " << buildMs << " ms" << std::endl
+              << "  refit    " << refitMs << " ms (" << objects / 10 << " moved)" << std::endl
+              << "  frustum  " << frustumMs * 1000.0 << " us/query, " << found / queries << " visible"
+              << "  (brute force " << bruteMs * 1000.0 << " us, " << bruteFound / queries << " visible"
+              << (found == bruteFound ? "" : ", MISMATCH") << ")" << std::endl
+              << "  sphere   " << sphereMs * 1000.0 << " us/query, " << sphereFound / queries << " found" << std::endl
+              << "  aabb     " << boxMs * 1000.0 << " us/query, " << boxFound / queries << " found" << std::endl
+              << "  raycast  " << rayMs * 1000.0 << " us/query, " << rayHits << "/" << queries << " hit" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int queries = argc > 1 ? atoi(argv[1]) : 1000;
+    if (queries <= 0)
+        queries = 1000;
+    run(10000, queries);
+    run(100000, queries);
+    return 0;
+}
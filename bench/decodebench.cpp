@@ -0,0 +1,57 @@
+// decodebench : image decode throughput of JklDecodePool
+//
+//   decodebench [iterations] [directory]
+//
+// Decodes every .png in the directory (resources/ by default) iterations times, once for each
+// pool size from 1 to the number of hardware threads, and prints images/s and MB/s decoded.
+
+#include "../include/images.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    std::string directory = argc > 2 ? argv[2] : "resources";
+
+    std::vector<std::string> paths;
+    for (auto& entry : std::filesystem::directory_iterator(directory))
+        if (entry.path().extension() == ".png")
+            paths.push_back(entry.path().string());
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty() || iterations <= 0) {
+        std::cout << "no .png files in " << directory << std::endl;
+        return 1;
+    }
+
+    int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+    std::cout << paths.size() << " images x " << iterations << " iterations, 1.." << cores << " threads" << std::endl;
+
+    for (int threads = 1; threads <= cores; threads++) {
+        JklDecodePool pool(threads);
+        std::vector<std::future<JklImage>> decodes;
+        decodes.reserve(paths.size() * iterations);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+            for (auto& path : paths)
+                decodes.push_back(pool.decode(path, -1));
+        size_t bytes = 0;
+        for (auto& decode : decodes)
+            bytes += decode.get().bytes();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double images = (double)decodes.size();
+        std::cout << "threads " << threads
+                  << "  " << elapsed.count() * 1000.0 << " ms"
+                  << "  " << images / elapsed.count() << " images/s"
+                  << "  " << bytes / elapsed.count() / (1024.0 * 1024.0) << " MB/s"
+                  << "  pooled " << jklStagingPooledBytes() / 1024 << " KB" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,516 @@
+// jackalbench : frame time benchmark of a real scene running through the whole engine
+//
+//   jackalbench [--level file.jkl] [--instances N] [--frames N] [--warmup N] [--path spline.txt]
+//               [--out report.json] [--baseline baseline.json] [--threshold percent] [--headless]
+//               [--keep-geometry] [--occlusion] [--chunks level.jkc] [--chunk-radius R]
+//
+// Streams the level and N animated SONCANIM.fbx instances in, waits until everything is resident,
+// then flies the camera once around a closed Catmull-Rom spline over --frames frames. The spline
+// comes from --path (one "x y z" control point per line, at least 4) or is a loop around the level.
+// Every frame advances the animations by one tick and the camera by one step, so runs at any frame
+// rate draw the same frames. The level and the instances sit in a JklSceneIndex, every frame draws
+// what its BVH frustum query returns. --occlusion also rasterizes the level into a JklOcclusionBuffer
+// and skips the instances hidden behind it, the level's CPU geometry is kept for that.
+//
+// --chunks flies over a level cooked into chunks (jkcook level) instead, streamed by a
+// JklChunkedLevel: only chunks within --chunk-radius of the camera (default a quarter of the
+// level's largest side) are loaded, the rest are released as the camera moves on. Nothing waits
+// for the chunks, so the measured frames include their streaming. The report counts chunk loads,
+// releases and the most resident at once.
+//
+// The report holds mean/p50/p95/p99/max of the game thread frame time and of the GPU frame time
+// (GL_TIME_ELAPSED, see profiler.hpp), every frame's times and the profiler's scope statistics,
+// plus the process RSS and peak RSS once the scene is loaded. The bench drops CPU geometry after
+// upload like the game does, --keep-geometry keeps it so both can be compared.
+// With --baseline the mean, p95 and p99 are compared against an earlier report and the run fails
+// (exit code 1) when any of them is more than --threshold percent (default 10) slower.
+// Exit code 2 means there was no GL context, or the scene couldn't be loaded, the report written
+// or the baseline read, so a missing baseline is never mistaken for a regression.
+
+#include "../include/engineinit.hpp"
+#include "../include/graphics.hpp"
+#include "../include/streaming.hpp"
+#include "../include/sceneindex.hpp"
+#include "../include/levelchunks.hpp"
+#include "../include/profiler.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+int LastThingDrawn;
+Camera camera(glm::vec3(0.0f, 1.0f, 20.0f));
+
+static const unsigned int BENCH_WIDTH = 1280;
+static const unsigned int BENCH_HEIGHT = 720;
+
+struct JklBenchSummary {
+    int samples = 0;
+    double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+// nearest rank, the same rule the profiler uses
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t index = (size_t)std::ceil(p * sorted.size());
+    return sorted[std::min(std::max(index, (size_t)1), sorted.size()) - 1];
+}
+
+static JklBenchSummary summarize(const std::vector<double>& samples) {
+    JklBenchSummary summary;
+    summary.samples = (int)samples.size();
+    if (samples.empty())
+        return summary;
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (double sample : sorted)
+        sum += sample;
+    summary.mean = sum / sorted.size();
+    summary.p50 = percentile(sorted, 0.50);
+    summary.p95 = percentile(sorted, 0.95);
+    summary.p99 = percentile(sorted, 0.99);
+    summary.max = sorted.back();
+    return summary;
+}
+
+// closed Catmull-Rom loop through every control point, s in [0, 1) goes around once
+static glm::vec3 splinePoint(const std::vector<glm::vec3>& points, float s) {
+    int n = (int)points.size();
+    float f = (s - std::floor(s)) * n;
+    int i = (int)f;
+    float t = f - i;
+    const glm::vec3& p0 = points[(i + n - 1) % n];
+    const glm::vec3& p1 = points[i % n];
+    const glm::vec3& p2 = points[(i + 1) % n];
+    const glm::vec3& p3 = points[(i + 2) % n];
+    return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t * t
+        + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t * t * t);
+}
+
+static bool readSpline(const char* path, std::vector<glm::vec3>& points) {
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        glm::vec3 point;
+        if (fields >> point.x >> point.y >> point.z)
+            points.push_back(point);
+    }
+    return points.size() >= 4;
+}
+
+enum EBENCH_PHASE {
+    EBENCH_LOADING,
+    EBENCH_WARMUP,
+    EBENCH_MEASURE,
+    EBENCH_DONE,
+    EBENCH_FAILED
+};
+
+struct BenchScene : JklScene {
+    std::string levelPath = "resources/fj9.jkl";
+    std::string splinePath;
+    // a .jkc replaces levelPath, see the top of the file
+    std::string chunksPath;
+    float chunkRadius = 0.0f;
+    int instances = 16;
+    int frames = 1000;
+    int warmup = 60;
+
+    Shader* levelShader = nullptr;
+    JklStaticMeshAsset* level = nullptr;
+    JklModelAsset* model = nullptr;
+    std::vector<Animator> animators;
+    std::vector<glm::mat4> placements;
+    std::vector<glm::vec3> spline;
+    // the level and every instance, filled by setup() and only read by the render thread after
+    JklSceneIndex index;
+    int firstInstance = 0;
+    bool occlusionCulling = false;
+    JklOcclusionBuffer occlusion;
+    // with --chunks, level stays null. Only the render thread touches it once frames are recorded
+    JklChunkedLevel chunked;
+    bool chunksListed = false;
+    int maxResidentChunks = 0;
+
+    EBENCH_PHASE phase = EBENCH_LOADING;
+    int phaseFrames = 0;
+    std::chrono::steady_clock::time_point lastFrame;
+    std::vector<double> cpuFrames;
+    // process memory once everything is resident and set up
+    size_t loadedRss = 0;
+    size_t loadedPeakRss = 0;
+
+    void codeInit(void) override {
+        levelShader = new Shader("resources/levelarray.vs", "resources/levelarray.fs");
+        if (!chunksPath.empty())
+            chunksListed = chunked.load(chunksPath.c_str(), levelShader);
+        else
+            level = jklstreamStaticMesh(levelPath.c_str(), levelShader);
+        model = jklstreamModel("resources/SONCANIM.fbx", true);
+    };
+
+    // everything is resident, lay the instances and the camera path out over the level
+    const std::string& scenePath(void) const { return chunksPath.empty() ? levelPath : chunksPath; };
+
+    bool setup(void) {
+        JklAabb bounds;
+        if (level)
+            bounds = level->mesh.bounds;
+        for (const JklLevelChunk& chunk : chunked.chunks) {
+            bounds.expand(chunk.info.bounds.min);
+            bounds.expand(chunk.info.bounds.max);
+        }
+        if (!bounds.valid())
+            return false;
+        glm::vec3 center = bounds.center(), extents = bounds.extents();
+        if (!level)
+            chunked.prefetchRadius = chunkRadius > 0.0f ? chunkRadius : std::max(extents.x, std::max(extents.y, extents.z)) * 0.5f;
+
+        if (!splinePath.empty() && !readSpline(splinePath.c_str(), spline)) {
+            JKL_ERROR(ELOG_GAME, "ERROR::BENCH::BAD_SPLINE: %s", splinePath.c_str());
+            return false;
+        }
+        if (spline.empty()) {
+            const int points = 8;
+            for (int i = 0; i < points; i++) {
+                float angle = 2.0f * glm::pi<float>() * i / points;
+                spline.push_back(center + glm::vec3(std::cos(angle) * extents.x * 0.6f,
+                    extents.y * (i % 2 ? 0.2f : -0.2f), std::sin(angle) * extents.z * 0.6f));
+            }
+        }
+
+        int columns = (int)std::ceil(std::sqrt((float)instances));
+        for (int i = 0; i < instances; i++) {
+            float x = ((i % columns) + 0.5f) / columns - 0.5f;
+            float z = ((i / columns) + 0.5f) / columns - 0.5f;
+            glm::vec3 position(center.x + x * extents.x, bounds.min.y, center.z + z * extents.z);
+            placements.push_back(glm::translate(glm::mat4(1.0f), position));
+            // spread over the clip so the instances don't all hold the same pose
+            Animator animator(&model->animation);
+            animator.PlayAnimation(&model->animation);
+            animator.UpdateAnimation((float)i / std::max(instances, 1));
+            animators.push_back(animator);
+        }
+
+        if (level)
+            index.addStaticMesh(&level->mesh);
+        firstInstance = (int)index.size();
+        for (const glm::mat4& placement : placements)
+            index.addModel(&model->model, placement);
+        index.update();
+        return true;
+    };
+
+    void finish(EBENCH_PHASE last) {
+        phase = last;
+        glfwSetWindowShouldClose(window, true);
+    };
+
+    void codeFrame(JklFrame& frame) override {
+        auto now = std::chrono::steady_clock::now();
+        if (phase == EBENCH_MEASURE)
+            cpuFrames.push_back(std::chrono::duration<double, std::milli>(now - lastFrame).count());
+        lastFrame = now;
+
+        if (phase == EBENCH_LOADING) {
+            if ((level ? level->failed() : !chunksListed) || model->failed()) {
+                JKL_ERROR(ELOG_GAME, "ERROR::BENCH::SCENE_NOT_LOADED: %s", scenePath().c_str());
+                finish(EBENCH_FAILED);
+                return;
+            }
+            // chunks are left to stream in flight
+            if ((level && !level->resident()) || !model->resident()) {
+                frame.record([this](const JklFrame&) {
+                    if (level)
+                        level->acquire();
+                    model->acquire();
+                });
+                return;
+            }
+            if (!setup()) {
+                finish(EBENCH_FAILED);
+                return;
+            }
+            loadedRss = jklProcessRss();
+            loadedPeakRss = jklProcessPeakRss();
+            jklReportMemory("bench scene loaded");
+            phase = EBENCH_WARMUP;
+            phaseFrames = 0;
+        }
+        if (phase == EBENCH_WARMUP && phaseFrames == warmup) {
+            // loading and warm up frames stay out of the numbers
+            jklprofileResetStats();
+            cpuFrames.reserve(frames);
+            phase = EBENCH_MEASURE;
+            phaseFrames = 0;
+        }
+        if (phase == EBENCH_MEASURE && phaseFrames == frames) {
+            finish(EBENCH_DONE);
+            return;
+        }
+        if (phase != EBENCH_WARMUP && phase != EBENCH_MEASURE)
+            return;
+
+        // warm up frames fly the start of the path, so the first measured frame isn't the first drawn
+        float s = phase == EBENCH_MEASURE ? (float)phaseFrames / frames : 0.0f;
+        phaseFrames++;
+        camera.Position = splinePoint(spline, s);
+        glm::vec3 direction = splinePoint(spline, s + 0.001f) - camera.Position;
+        if (glm::length(direction) > 0.0f) {
+            direction = glm::normalize(direction);
+            camera.Yaw = glm::degrees(std::atan2(direction.z, direction.x));
+            camera.Pitch = glm::degrees(std::asin(glm::clamp(direction.y, -1.0f, 1.0f)));
+            camera.updateCameraVectors();
+        }
+        frame.projection = glm::perspective(glm::radians(camera.Zoom), (float)BENCH_WIDTH / (float)BENCH_HEIGHT, 0.1f, 20000.0f);
+        frame.view = camera.GetViewMatrix();
+        frame.eye = camera.Position;
+
+        // every instance's placement followed by its bones, instance i starts at first + i * (bones + 1)
+        size_t first = frame.matrices.size();
+        int boneCount = 0;
+        for (size_t i = 0; i < animators.size(); i++) {
+            animators[i].UpdateAnimation(jklFixedDeltaTime);
+            const std::vector<glm::mat4>& bones = animators[i].GetFinalBoneMatrices();
+            frame.pushMatrices(&placements[i], 1);
+            frame.pushMatrices(bones.data(), bones.size());
+            boneCount = (int)bones.size();
+        }
+
+        frame.record([this, first, boneCount](const JklFrame& f) {
+            bool levelReady = level && level->acquire(), modelReady = model->acquire();
+            glm::mat4 viewProjection = f.projection * f.view;
+            JklFrustum frustum(viewProjection);
+            if (!level) {
+                chunked.update(f.eye);
+                levelShader->use();
+                levelShader->setMat4("projection", f.projection);
+                levelShader->setMat4("view", f.view);
+                chunked.draw(f.eye, viewProjection);
+                maxResidentChunks = std::max(maxResidentChunks, chunked.residentChunks());
+            }
+            bool modelShaderSet = false;
+            for (int id : occlusionCulling ? index.cull(viewProjection, occlusion) : index.cull(viewProjection)) {
+                if (index.type(id) == ESCENE_STATICMESH) {
+                    if (!levelReady)
+                        continue;
+                    levelShader->use();
+                    levelShader->setMat4("projection", f.projection);
+                    levelShader->setMat4("view", f.view);
+                    index.staticMesh(id)->DrawVisible(f.eye, viewProjection, index.transform(id));
+                    modelShaderSet = false;
+                    continue;
+                }
+                if (!modelReady)
+                    continue;
+                if (!modelShaderSet) {
+                    MODELSHADER->use();
+                    MODELSHADER->setInt("texture_diffuse1", 0);
+                    MODELSHADER->setMat4("projection", f.projection);
+                    MODELSHADER->setMat4("view", f.view);
+                    modelShaderSet = true;
+                }
+                size_t at = first + (size_t)(id - firstInstance) * (boneCount + 1);
+                if (boneCount > 0)
+                    MODELSHADER->setMat4Array("finalBonesMatrices", &f.matrices[at + 1], boneCount);
+                MODELSHADER->setMat4("model", f.matrices[at]);
+                index.model(id)->Draw(*MODELSHADER, frustum, f.matrices[at]);
+            }
+        });
+    };
+};
+
+static void writeSummary(FILE* out, const char* name, const JklBenchSummary& summary) {
+    fprintf(out, "  \"%s\": {\"samples\": %d, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+        name, summary.samples, summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+}
+
+static void writeSamples(FILE* out, const char* name, const std::vector<double>& samples, bool last) {
+    fprintf(out, "  \"%s\": [", name);
+    for (size_t i = 0; i < samples.size(); i++)
+        fprintf(out, "%s%.4f", i ? ", " : "", samples[i]);
+    fprintf(out, "]%s\n", last ? "" : ",");
+}
+
+// a JSON string body, paths may hold quotes and Windows paths hold backslashes
+static std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if ((unsigned char)c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+            escaped += code;
+        }
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+static bool writeReport(const char* path, const BenchScene& scene, const std::vector<double>& gpuFrames) {
+    FILE* out = fopen(path, "wb");
+    if (!out)
+        return false;
+    fprintf(out, "{\n");
+    fprintf(out, "  \"level\": \"%s\",\n", jsonEscape(scene.scenePath()).c_str());
+    fprintf(out, "  \"instances\": %d,\n", scene.instances);
+    fprintf(out, "  \"frames\": %d,\n", scene.frames);
+    fprintf(out, "  \"headless\": %s,\n", jklHeadless ? "true" : "false");
+    fprintf(out, "  \"keepCpuGeometry\": %s,\n", jklKeepCpuGeometry ? "true" : "false");
+    fprintf(out, "  \"occlusion\": %s,\n", scene.occlusionCulling ? "true" : "false");
+    fprintf(out, "  \"chunks\": {\"count\": %zu, \"radius\": %.4f, \"loads\": %d, \"releases\": %d, \"maxResident\": %d},\n",
+        scene.chunked.chunks.size(), scene.chunksPath.empty() ? 0.0f : scene.chunked.prefetchRadius, scene.chunked.loads,
+        scene.chunked.releases, scene.maxResidentChunks);
+    fprintf(out, "  \"rssKB\": %zu,\n", scene.loadedRss / 1024);
+    fprintf(out, "  \"peakRssKB\": %zu,\n", scene.loadedPeakRss / 1024);
+    writeSummary(out, "cpu", summarize(scene.cpuFrames));
+    writeSummary(out, "gpu", summarize(gpuFrames));
+    fprintf(out, "  \"scopes\": [");
+    std::vector<JklProfileStats> scopes = jklprofileAllStats();
+    for (size_t i = 0; i < scopes.size(); i++)
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"gpu\": %s, \"counter\": %s, \"samples\": %d, \"mean\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+            i ? "," : "", jsonEscape(scopes[i].name).c_str(), scopes[i].gpu ? "true" : "false", scopes[i].counter ? "true" : "false", scopes[i].samples,
+            scopes[i].mean, scopes[i].p95, scopes[i].p99, scopes[i].max);
+    fprintf(out, "\n  ],\n");
+    writeSamples(out, "cpuFrames", scene.cpuFrames, false);
+    writeSamples(out, "gpuFrames", gpuFrames, true);
+    fprintf(out, "}\n");
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
+
+// enough JSON for our own reports: the number after "key" inside the "section" object
+static bool readMetric(const std::string& json, const char* section, const char* key, double& out) {
+    size_t start = json.find("\"" + std::string(section) + "\"");
+    if (start == std::string::npos)
+        return false;
+    size_t end = json.find('}', start);
+    size_t at = json.find("\"" + std::string(key) + "\"", start);
+    if (at == std::string::npos || at > end)
+        return false;
+    at = json.find(':', at);
+    if (at == std::string::npos || at > end)
+        return false;
+    out = strtod(json.c_str() + at + 1, nullptr);
+    return true;
+}
+
+// the exit code: 0 when nothing got slower than the threshold allows, 1 on a regression, 2 when
+// the baseline can't be read
+static int compareBaseline(const char* reportPath, const char* baselinePath, double threshold) {
+    std::ifstream reportFile(reportPath), baselineFile(baselinePath);
+    if (!baselineFile) {
+        JKL_ERROR(ELOG_GAME, "ERROR::BENCH::NO_BASELINE: %s", baselinePath);
+        return 2;
+    }
+    std::stringstream report, baseline;
+    report << reportFile.rdbuf();
+    baseline << baselineFile.rdbuf();
+
+    bool passed = true;
+    const char* sections[] = {"cpu", "gpu"};
+    const char* keys[] = {"mean", "p95", "p99"};
+    for (const char* section : sections) {
+        for (const char* key : keys) {
+            double now = 0.0, before = 0.0, samples = 0.0, baseSamples = 0.0;
+            // a run without GPU timings (no timer queries, or a build without JKL_PROFILE) compares CPU only
+            if (!readMetric(report.str(), section, "samples", samples) || samples <= 0.0
+                || !readMetric(baseline.str(), section, "samples", baseSamples) || baseSamples <= 0.0)
+                continue;
+            if (!readMetric(report.str(), section, key, now) || !readMetric(baseline.str(), section, key, before) || before <= 0.0)
+                continue;
+            double change = (now - before) / before * 100.0;
+            bool regressed = change > threshold;
+            JKL_INFO(ELOG_GAME, "%s %-4s %8.3f ms  baseline %8.3f ms  %+6.1f%%%s", section, key, now, before, change,
+                regressed ? "  REGRESSION" : "");
+            passed = passed && !regressed;
+        }
+    }
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    BenchScene scene;
+    const char* reportPath = "jackal_bench.json";
+    const char* baselinePath = nullptr;
+    double threshold = 10.0;
+    bool keepGeometry = false;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0)
+            jklHeadless = true;
+        else if (strcmp(argv[i], "--level") == 0 && hasValue)
+            scene.levelPath = argv[++i];
+        else if (strcmp(argv[i], "--instances") == 0 && hasValue)
+            scene.instances = std::max(atoi(argv[++i]), 0);
+        else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+            scene.frames = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+            scene.warmup = std::max(atoi(argv[++i]), 0);
+        else if (strcmp(argv[i], "--path") == 0 && hasValue)
+            scene.splinePath = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && hasValue)
+            reportPath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+            baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && hasValue)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--keep-geometry") == 0)
+            keepGeometry = true;
+        else if (strcmp(argv[i], "--occlusion") == 0)
+            scene.occlusionCulling = true;
+        else if (strcmp(argv[i], "--chunks") == 0 && hasValue)
+            scene.chunksPath = argv[++i];
+        else if (strcmp(argv[i], "--chunk-radius") == 0 && hasValue)
+            scene.chunkRadius = (float)atof(argv[++i]);
+        else {
+            fprintf(stderr, "usage: jackalbench [--level file.jkl] [--instances N] [--frames N] [--warmup N] [--path spline.txt]\n"
+                "                   [--out report.json] [--baseline baseline.json] [--threshold percent] [--headless]\n"
+                "                   [--keep-geometry] [--occlusion] [--chunks level.jkc] [--chunk-radius R]\n");
+            return 2;
+        }
+    }
+
+    // the bench ends the run itself once the measured frames are done
+    jklHeadlessFrames = INT_MAX;
+    if (!jklstart(BENCH_WIDTH, BENCH_HEIGHT))
+        return 2;
+    // the occluders are the level's CPU triangles
+    jklKeepCpuGeometry = keepGeometry || scene.occlusionCulling;
+    jklRenderThread = true;
+    // every measured frame stays in the profiler's window
+    jklProfileWindow = std::max(jklProfileWindow, scene.frames);
+    jklsetScene(&scene);
+    jklrun();
+    glfwTerminate();
+
+    if (scene.phase != EBENCH_DONE)
+        return 2;
+    std::vector<double> gpuFrames;
+    jklprofileSamples("frame", gpuFrames, true);
+    if (!writeReport(reportPath, scene, gpuFrames)) {
+        JKL_ERROR(ELOG_GAME, "ERROR::BENCH::REPORT_NOT_WRITTEN: %s", reportPath);
+        return 2;
+    }
+    JklBenchSummary cpu = summarize(scene.cpuFrames);
+    JKL_INFO(ELOG_GAME, "%d frames, cpu mean %.3f ms p95 %.3f ms p99 %.3f ms, report in %s", cpu.samples, cpu.mean, cpu.p95, cpu.p99, reportPath);
+    if (!scene.chunksPath.empty())
+        JKL_INFO(ELOG_GAME, "%zu chunks, %d loads, %d releases, at most %d resident", scene.chunked.chunks.size(),
+            scene.chunked.loads, scene.chunked.releases, scene.maxResidentChunks);
+    return baselinePath ? compareBaseline(reportPath, baselinePath, threshold) : 0;
+}
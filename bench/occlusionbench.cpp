@@ -0,0 +1,117 @@
+// occlusionbench : JklOcclusionBuffer rasterization and query cost, no GPU needed
+//
+//   occlusionbench [width] [height]
+//
+// Rasterizes a finely tessellated wall 20 units in front of the camera, split into 1 up to one band
+// per hardware thread on the job system, then tests 10k random boxes against it.
+// Boxes in front of the wall must never come back occluded, boxes well behind its middle must.
+
+#include "../include/occlusion.hpp"
+#include "../include/jobs.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? atoi(argv[1]) : 256;
+    int height = argc > 2 ? atoi(argv[2]) : 128;
+    if (width <= 0 || height <= 0) {
+        width = 256;
+        height = 128;
+    }
+
+    // camera at the origin looking down -z, 90 degree vertical field of view
+    const float aspect = 2.0f, zNear = 0.1f, zFar = 500.0f;
+    glm::mat4 projection(0.0f);
+    projection[0][0] = 1.0f / aspect;
+    projection[1][1] = 1.0f;
+    projection[2][2] = -(zFar + zNear) / (zFar - zNear);
+    projection[2][3] = -1.0f;
+    projection[3][2] = -2.0f * zFar * zNear / (zFar - zNear);
+
+    // 60 x 40 wall at z = -20 split into 200 x 100 quads
+    const int columns = 200, rows = 100;
+    const float wallZ = -20.0f, halfWidth = 30.0f, halfHeight = 20.0f;
+    std::vector<glm::vec3> wall;
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < columns; c++) {
+            float x0 = -halfWidth + 2.0f * halfWidth * c / columns, x1 = -halfWidth + 2.0f * halfWidth * (c + 1) / columns;
+            float y0 = -halfHeight + 2.0f * halfHeight * r / rows, y1 = -halfHeight + 2.0f * halfHeight * (r + 1) / rows;
+            wall.push_back(glm::vec3(x0, y0, wallZ));
+            wall.push_back(glm::vec3(x1, y0, wallZ));
+            wall.push_back(glm::vec3(x1, y1, wallZ));
+            wall.push_back(glm::vec3(x0, y0, wallZ));
+            wall.push_back(glm::vec3(x1, y1, wallZ));
+            wall.push_back(glm::vec3(x0, y1, wallZ));
+        }
+    }
+
+    JklOcclusionBuffer buffer(width, height);
+    int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+    jkljobStart(cores - 1);
+    std::cout << buffer.width() << "x" << buffer.height() << " buffer, " << wall.size() / 3 << " occluder triangles" << std::endl;
+    for (int threads = 1; threads <= cores; threads++) {
+        const int repeats = 20;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++) {
+            buffer.begin(projection);
+            buffer.addOccluder(wall.data(), wall.size(), glm::mat4(1.0f));
+            buffer.rasterize(threads);
+        }
+        std::cout << "bands " << threads << "  " << millisecondsSince(start) / repeats << " ms/frame" << std::endl;
+    }
+    jkljobReport();
+    jkljobStop();
+
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<float> xy(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> depth(-100.0f, -5.0f);
+    std::uniform_real_distribution<float> size(0.2f, 2.0f);
+    std::vector<JklAabb> boxes(10000);
+    for (auto& box : boxes) {
+        glm::vec3 c(xy(rng), xy(rng), depth(rng));
+        glm::vec3 e(size(rng));
+        box.expand(c - e);
+        box.expand(c + e);
+    }
+
+    int occluded = 0, wrong = 0, missed = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<char> visible(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+        visible[i] = buffer.testAabb(boxes[i]);
+    double testUs = millisecondsSince(start) * 1000.0 / boxes.size();
+
+    for (size_t i = 0; i < boxes.size(); i++) {
+        const JklAabb& box = boxes[i];
+        if (!visible[i]) {
+            occluded++;
+            if (box.max.z > wallZ)
+                wrong++;
+        }
+        else {
+            // behind the wall, and its silhouette seen from the origin stays inside the wall's half extents
+            bool hidden = box.max.z < wallZ - 1.0f;
+            for (int c = 0; c < 8 && hidden; c++) {
+                glm::vec3 corner((c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z);
+                float scale = wallZ / corner.z;
+                hidden = std::fabs(corner.x * scale) < halfWidth * 0.9f && std::fabs(corner.y * scale) < halfHeight * 0.9f;
+            }
+            if (hidden)
+                missed++;
+        }
+    }
+
+    std::cout << boxes.size() << " boxes  " << testUs << " us/test  occluded " << occluded
+              << "  wrongly occluded " << wrong << "  missed " << missed << std::endl;
+    return wrong == 0 ? 0 : 1;
+}
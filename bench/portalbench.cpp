@@ -0,0 +1,142 @@
+// portalbench : JklCellGraph portal walk cost and coverage, no GPU needed
+//
+//   portalbench [queries]
+//
+// Generates cells for open floors of 8x8, 20x20 and 32x32 one unit cells, where every shared face
+// is a portal, and walks them from random eyes looking in random directions. Nothing blocks the
+// view on an open floor, so every cell whose floor shows on screen must come back from the walk;
+// the floor quads are clipped to the view volume to find those, the box test of frustum culling
+// also keeps some just outside its corners. Exits 1 when the walk misses one. A floor split by a
+// wall with one doorway shows what the walk culls.
+
+#include "../include/portals.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static glm::mat4 viewProjection(const glm::vec3& eye, const glm::vec3& forward) {
+    return glm::perspective(1.2f, 16.0f / 9.0f, 0.1f, 500.0f) * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static void quad(std::vector<glm::vec3>& points, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+    points.insert(points.end(), {a, b, c, a, c, d});
+}
+
+// whether the floor quad of a cell keeps any area once clipped to the view volume
+static bool quadOnScreen(const JklAabb& box, const glm::mat4& matrix) {
+    std::vector<glm::vec4> polygon, clipped;
+    const glm::vec3 corners[4] = {glm::vec3(box.min.x, box.min.y, box.min.z), glm::vec3(box.max.x, box.min.y, box.min.z),
+                                  glm::vec3(box.max.x, box.min.y, box.max.z), glm::vec3(box.min.x, box.min.y, box.max.z)};
+    for (const glm::vec3& corner : corners)
+        polygon.push_back(matrix * glm::vec4(corner, 1.0f));
+    // -w <= x, y, z <= w
+    for (int plane = 0; plane < 6 && polygon.size() >= 3; plane++) {
+        int axis = plane / 2;
+        float sign = plane % 2 ? -1.0f : 1.0f;
+        clipped.clear();
+        for (size_t i = 0; i < polygon.size(); i++) {
+            const glm::vec4& a = polygon[i];
+            const glm::vec4& b = polygon[(i + 1) % polygon.size()];
+            float da = a.w + sign * a[axis], db = b.w + sign * b[axis];
+            if (da >= 0.0f)
+                clipped.push_back(a);
+            if ((da >= 0.0f) != (db >= 0.0f))
+                clipped.push_back(a + (b - a) * (da / (da - db)));
+        }
+        polygon.swap(clipped);
+    }
+    float area = 0.0f;
+    for (size_t i = 0; polygon.size() >= 3 && i < polygon.size(); i++) {
+        const glm::vec4& a = polygon[i];
+        const glm::vec4& b = polygon[(i + 1) % polygon.size()];
+        area += a.x / a.w * (b.y / b.w) - b.x / b.w * (a.y / a.w);
+    }
+    return std::fabs(area) > 1e-6f;
+}
+
+// size x size floor at y = 0, with wall a solid wall across x = size / 2 except for one doorway
+static std::vector<glm::vec3> floorLevel(int size, bool wall) {
+    std::vector<glm::vec3> points;
+    for (int z = 0; z < size; z++)
+        for (int x = 0; x < size; x++)
+            quad(points, glm::vec3(x, 0, z), glm::vec3(x + 1, 0, z), glm::vec3(x + 1, 0, z + 1), glm::vec3(x, 0, z + 1));
+    if (wall) {
+        float wx = size / 2.0f;
+        for (int z = 0; z < size; z++)
+            if (z != size / 2)
+                quad(points, glm::vec3(wx, 0, z), glm::vec3(wx, 0, z + 1), glm::vec3(wx, 1, z + 1), glm::vec3(wx, 1, z));
+    }
+    return points;
+}
+
+// walks the floor from queries random eyes, returns the on screen cells the walk missed
+static int run(int size, bool wall, int queries) {
+    std::vector<glm::vec3> points = floorLevel(size, wall);
+    JklCellGraph graph;
+    auto start = std::chrono::steady_clock::now();
+    graph.generate(points.data(), points.size(), 1.0f);
+    double generateMs = millisecondsSince(start);
+    graph.assignTriangles(points.data(), points.size());
+
+    std::mt19937 rng(size * 31 + wall);
+    std::uniform_real_distribution<float> position(0.05f, size - 0.05f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    size_t walked = 0, framed = 0, onScreen = 0;
+    int missed = 0;
+    double walkMs = 0.0;
+    for (int q = 0; q < queries; q++) {
+        glm::vec3 eye(position(rng), 0.5f, position(rng));
+        glm::vec3 forward = glm::normalize(glm::vec3(unit(rng), unit(rng) * 0.3f, unit(rng)) + glm::vec3(0.001f, 0.0f, 0.0f));
+        glm::mat4 matrix = viewProjection(eye, forward);
+
+        JklFrameVector<int> visible;
+        auto start = std::chrono::steady_clock::now();
+        graph.visibleCells(eye, matrix, visible);
+        walkMs += millisecondsSince(start);
+
+        std::vector<char> seen(graph.cells.size(), 0);
+        for (int cell : visible)
+            seen[cell] = 1;
+        JklFrustum frustum(matrix);
+        for (size_t i = 0; i < graph.cells.size(); i++) {
+            framed += frustum.testAabb(graph.cells[i].drawBounds);
+            if (!quadOnScreen(graph.cells[i].drawBounds, matrix))
+                continue;
+            onScreen++;
+            if (!wall && !seen[i])
+                missed++;
+        }
+        walked += visible.size();
+    }
+
+    std::cout << size << "x" << size << (wall ? " with wall " : " open      ") << graph.cells.size() << " cells "
+              << graph.portals.size() << " portals  generate " << generateMs << " ms  " << walkMs / queries << " ms/walk  cells per query: walk "
+              << (double)walked / queries << "  frustum " << (double)framed / queries << "  on screen " << (double)onScreen / queries;
+    if (!wall)
+        std::cout << "  missed " << missed;
+    std::cout << std::endl;
+    return missed;
+}
+
+int main(int argc, char** argv) {
+    int queries = argc > 1 ? atoi(argv[1]) : 200;
+    if (queries <= 0)
+        queries = 200;
+
+    int missed = 0;
+    for (int size : {8, 20, 32})
+        missed += run(size, false, queries);
+    run(32, true, queries);
+    return missed == 0 ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+#include "include/bvh.hpp"
+#include "include/profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static float surfaceArea(const JklAabb& box) {
+    if (!box.valid())
+        return 0.0f;
+    glm::vec3 d = box.max - box.min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+void JklBvh::build(const std::vector<JklAabb>& objectBoxes) {
+    boxes = objectBoxes;
+    nodes.clear();
+    order.resize(boxes.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = (int)i;
+    dirty = false;
+    if (boxes.empty())
+        return;
+
+    std::vector<glm::vec3> centroids(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+        centroids[i] = boxes[i].center();
+
+    // a binary tree with leaves of at least one object never needs more than 2n - 1 nodes
+    nodes.reserve(boxes.size() * 2);
+    nodes.push_back(Node{JklAabb(), 0, 0, (int)boxes.size()});
+    split(0, centroids, 0);
+}
+
+void JklBvh::split(int index, std::vector<glm::vec3>& centroids, int depth) {
+    int first = nodes[index].first, count = nodes[index].count;
+    JklAabb box, centroidBox;
+    for (int i = first; i < first + count; i++) {
+        box.expand(boxes[order[i]]);
+        centroidBox.expand(centroids[order[i]]);
+    }
+    nodes[index].box = box;
+    if (count <= LEAF_SIZE || depth >= MAX_DEPTH)
+        return;
+
+    // cheapest binned SAH split over all three axes
+    float bestCost = INFINITY;
+    int bestAxis = -1, bestBin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = centroidBox.min[axis], hi = centroidBox.max[axis];
+        if (hi <= lo)
+            continue;
+        float scale = BINS / (hi - lo);
+
+        JklAabb binBoxes[BINS];
+        int binCounts[BINS] = {0};
+        for (int i = first; i < first + count; i++) {
+            int bin = std::min((int)((centroids[order[i]][axis] - lo) * scale), BINS - 1);
+            binBoxes[bin].expand(boxes[order[i]]);
+            binCounts[bin]++;
+        }
+
+        // sweep from the right to get the area and count of everything right of each plane
+        float rightArea[BINS];
+        int rightCount[BINS];
+        JklAabb right;
+        int rightTotal = 0;
+        for (int b = BINS - 1; b > 0; b--) {
+            right.expand(binBoxes[b]);
+            rightTotal += binCounts[b];
+            rightArea[b] = surfaceArea(right);
+            rightCount[b] = rightTotal;
+        }
+        JklAabb left;
+        int leftTotal = 0;
+        for (int b = 0; b < BINS - 1; b++) {
+            left.expand(binBoxes[b]);
+            leftTotal += binCounts[b];
+            if (leftTotal == 0 || rightCount[b + 1] == 0)
+                continue;
+            float cost = surfaceArea(left) * leftTotal + rightArea[b + 1] * rightCount[b + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b;
+            }
+        }
+    }
+
+    // splitting has to beat intersecting every object of the node
+    float leafCost = surfaceArea(box) * count;
+    int middle;
+    if (bestAxis < 0 || bestCost >= leafCost) {
+        if (bestAxis < 0 && count > LEAF_SIZE * 4) {
+            // every centroid in one spot, halve the list so leaves stay small
+            middle = first + count / 2;
+        }
+        else {
+            return;
+        }
+    }
+    else {
+        float lo = centroidBox.min[bestAxis];
+        float scale = BINS / (centroidBox.max[bestAxis] - lo);
+        auto mid = std::partition(order.begin() + first, order.begin() + first + count, [&](int object) {
+            return std::min((int)((centroids[object][bestAxis] - lo) * scale), BINS - 1) <= bestBin;
+        });
+        middle = (int)(mid - order.begin());
+    }
+
+    int left = (int)nodes.size();
+    nodes.push_back(Node{JklAabb(), 0, first, middle - first});
+    nodes.push_back(Node{JklAabb(), 0, middle, first + count - middle});
+    nodes[index].left = left;
+    nodes[index].count = 0;
+    split(left, centroids, depth + 1);
+    split(left + 1, centroids, depth + 1);
+}
+
+void JklBvh::refit(void) {
+    if (!dirty)
+        return;
+    for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+        Node& node = nodes[i];
+        JklAabb box;
+        if (node.count > 0) {
+            for (int j = node.first; j < node.first + node.count; j++)
+                box.expand(boxes[order[j]]);
+        }
+        else {
+            box = nodes[node.left].box;
+            box.expand(nodes[node.left + 1].box);
+        }
+        node.box = box;
+    }
+    dirty = false;
+}
+
+void JklBvh::collect(int index, std::vector<int>& out) const {
+    int stack[64];
+    int top = 0;
+    stack[top++] = index;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (node.count > 0)
+            out.insert(out.end(), order.begin() + node.first, order.begin() + node.first + node.count);
+        else {
+            stack[top++] = node.left;
+            stack[top++] = node.left + 1;
+        }
+    }
+}
+
+void JklBvh::queryFrustum(const JklFrustum& frustum, std::vector<int>& out) const {
+    JKL_PROFILE_SCOPE("bvhQuery");
+    if (nodes.empty())
+        return;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int index = stack[--top];
+        const Node& node = nodes[index];
+        if (!frustum.testAabb(node.box))
+            continue;
+        // fully inside, everything below is visible without further plane tests
+        if (frustum.containsAabb(node.box)) {
+            collect(index, out);
+            continue;
+        }
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++)
+                if (frustum.testAabb(boxes[order[i]]))
+                    out.push_back(order[i]);
+        }
+        else {
+            stack[top++] = node.left;
+            stack[top++] = node.left + 1;
+        }
+    }
+}
+
+static bool sphereTouches(const JklSphere& sphere, const JklAabb& box) {
+    glm::vec3 nearest = glm::clamp(sphere.center, box.min, box.max);
+    glm::vec3 d = nearest - sphere.center;
+    return glm::dot(d, d) <= sphere.radius * sphere.radius;
+}
+
+static bool boxesTouch(const JklAabb& a, const JklAabb& b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+void JklBvh::querySphere(const JklSphere& sphere, std::vector<int>& out) const {
+    if (nodes.empty())
+        return;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!sphereTouches(sphere, node.box))
+            continue;
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++)
+                if (sphereTouches(sphere, boxes[order[i]]))
+                    out.push_back(order[i]);
+        }
+        else {
+            stack[top++] = node.left;
+            stack[top++] = node.left + 1;
+        }
+    }
+}
+
+void JklBvh::queryAabb(const JklAabb& box, std::vector<int>& out) const {
+    if (nodes.empty())
+        return;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!boxesTouch(box, node.box))
+            continue;
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++)
+                if (boxesTouch(box, boxes[order[i]]))
+                    out.push_back(order[i]);
+        }
+        else {
+            stack[top++] = node.left;
+            stack[top++] = node.left + 1;
+        }
+    }
+}
+
+bool jklRayAabb(const glm::vec3& origin, const glm::vec3& inverseDirection, const JklAabb& box, float maxDistance, float& t) {
+    float tmin = 0.0f, tmax = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (box.min[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (box.max[axis] - origin[axis]) * inverseDirection[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tmin = t0 > tmin ? t0 : tmin;
+        tmax = t1 < tmax ? t1 : tmax;
+        if (tmin > tmax)
+            return false;
+    }
+    t = tmin;
+    return true;
+}
+
+void JklBvh::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<int>& out) const {
+    if (nodes.empty())
+        return;
+    glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    float t;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!jklRayAabb(origin, inverse, node.box, maxDistance, t))
+            continue;
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++)
+                if (jklRayAabb(origin, inverse, boxes[order[i]], maxDistance, t))
+                    out.push_back(order[i]);
+        }
+        else {
+            stack[top++] = node.left;
+            stack[top++] = node.left + 1;
+        }
+    }
+}
+
+int JklBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance,
+    const std::function<bool(int object, float& t)>& exact) const {
+    int hit = -1;
+    if (nodes.empty())
+        return hit;
+    glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    float t;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        // distance shrinks with every hit, so later subtrees get rejected earlier
+        if (!jklRayAabb(origin, inverse, node.box, distance, t))
+            continue;
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                if (!jklRayAabb(origin, inverse, boxes[order[i]], distance, t))
+                    continue;
+                if (exact && !exact(order[i], t))
+                    continue;
+                if (t < distance) {
+                    distance = t;
+                    hit = order[i];
+                }
+            }
+            continue;
+        }
+        // visit the nearer child first
+        float tl = INFINITY, tr = INFINITY;
+        bool hl = jklRayAabb(origin, inverse, nodes[node.left].box, distance, tl);
+        bool hr = jklRayAabb(origin, inverse, nodes[node.left + 1].box, distance, tr);
+        if (hl && hr) {
+            if (tl < tr) {
+                stack[top++] = node.left + 1;
+                stack[top++] = node.left;
+            }
+            else {
+                stack[top++] = node.left;
+                stack[top++] = node.left + 1;
+            }
+        }
+        else if (hl)
+            stack[top++] = node.left;
+        else if (hr)
+            stack[top++] = node.left + 1;
+    }
+    return hit;
+}
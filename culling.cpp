@@ -0,0 +1,162 @@
+#include "include/culling.hpp"
+
+#include <cmath>
+
+JklCullStats jklCullStats;
+
+JklAabb JklAabb::transformed(const glm::mat4& m) const {
+    if (!valid())
+        return *this;
+    glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1.0f));
+    glm::vec3 e = extents();
+    // each world axis extent is the absolute row of the 3x3 part dotted with the local extents
+    glm::vec3 we;
+    for (int i = 0; i < 3; i++)
+        we[i] = std::fabs(m[0][i]) * e.x + std::fabs(m[1][i]) * e.y + std::fabs(m[2][i]) * e.z;
+    JklAabb out;
+    out.min = c - we;
+    out.max = c + we;
+    return out;
+}
+
+JklSphere JklSphere::transformed(const glm::mat4& m) const {
+    JklSphere out;
+    out.center = glm::vec3(m * glm::vec4(center, 1.0f));
+    float sx = glm::length(glm::vec3(m[0]));
+    float sy = glm::length(glm::vec3(m[1]));
+    float sz = glm::length(glm::vec3(m[2]));
+    out.radius = radius * std::fmax(sx, std::fmax(sy, sz));
+    return out;
+}
+
+JklSphere jklBoundingSphere(const JklAabb& box, const glm::vec3* points, size_t count, size_t stride) {
+    JklSphere sphere;
+    if (!box.valid())
+        return sphere;
+    sphere.center = box.center();
+    float radius2 = 0.0f;
+    const unsigned char* p = (const unsigned char*)points;
+    for (size_t i = 0; i < count; i++, p += stride) {
+        glm::vec3 d = *(const glm::vec3*)p - sphere.center;
+        radius2 = std::fmax(radius2, glm::dot(d, d));
+    }
+    sphere.radius = std::sqrt(radius2);
+    return sphere;
+}
+
+void JklFrustum::extract(const glm::mat4& m) {
+    // Gribb/Hartmann: rows of the clip matrix added to / subtracted from the w row. glm is column major
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    glm::vec4 planes[6] = {
+        row3 + row0,    // left
+        row3 - row0,    // right
+        row3 + row1,    // bottom
+        row3 - row1,    // top
+        row3 + row2,    // near
+        row3 - row2     // far
+    };
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 p = planes[i < 6 ? i : 0];
+        float length = glm::length(glm::vec3(p));
+        if (length > 0.0f)
+            p = p * (1.0f / length);
+        nx[i] = p.x;
+        ny[i] = p.y;
+        nz[i] = p.z;
+        nd[i] = p.w;
+    }
+}
+
+bool JklFrustum::testAabb(const JklAabb& box) const {
+    if (!box.valid())
+        return false;
+    glm::vec3 c = box.center();
+    glm::vec3 e = box.extents();
+#ifdef JKL_SSE
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+    for (int i = 0; i < 8; i += 4) {
+        __m128 px = _mm_load_ps(nx + i), py = _mm_load_ps(ny + i), pz = _mm_load_ps(nz + i);
+        // signed distance of the centre plus the box's projected radius onto the normal
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, px), _mm_mul_ps(cy, py)),
+            _mm_add_ps(_mm_mul_ps(cz, pz), _mm_load_ps(nd + i)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_andnot_ps(signMask, px)),
+            _mm_mul_ps(ey, _mm_andnot_ps(signMask, py))), _mm_mul_ps(ez, _mm_andnot_ps(signMask, pz)));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps())) != 0)
+            return false;
+    }
+    return true;
+#else
+    for (int i = 0; i < 6; i++) {
+        float dist = c.x * nx[i] + c.y * ny[i] + c.z * nz[i] + nd[i];
+        float radius = e.x * std::fabs(nx[i]) + e.y * std::fabs(ny[i]) + e.z * std::fabs(nz[i]);
+        if (dist + radius < 0.0f)
+            return false;
+    }
+    return true;
+#endif
+}
+
+bool JklFrustum::containsAabb(const JklAabb& box) const {
+    if (!box.valid())
+        return false;
+    glm::vec3 c = box.center();
+    glm::vec3 e = box.extents();
+#ifdef JKL_SSE
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+    for (int i = 0; i < 8; i += 4) {
+        __m128 px = _mm_load_ps(nx + i), py = _mm_load_ps(ny + i), pz = _mm_load_ps(nz + i);
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, px), _mm_mul_ps(cy, py)),
+            _mm_add_ps(_mm_mul_ps(cz, pz), _mm_load_ps(nd + i)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_andnot_ps(signMask, px)),
+            _mm_mul_ps(ey, _mm_andnot_ps(signMask, py))), _mm_mul_ps(ez, _mm_andnot_ps(signMask, pz)));
+        // the corner nearest to the plane has to be on its inner side
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(dist, radius), _mm_setzero_ps())) != 0)
+            return false;
+    }
+    return true;
+#else
+    for (int i = 0; i < 6; i++) {
+        float dist = c.x * nx[i] + c.y * ny[i] + c.z * nz[i] + nd[i];
+        float radius = e.x * std::fabs(nx[i]) + e.y * std::fabs(ny[i]) + e.z * std::fabs(nz[i]);
+        if (dist - radius < 0.0f)
+            return false;
+    }
+    return true;
+#endif
+}
+
+bool JklFrustum::testSphere(const JklSphere& sphere) const {
+    if (!sphere.valid())
+        return false;
+#ifdef JKL_SSE
+    __m128 cx = _mm_set1_ps(sphere.center.x), cy = _mm_set1_ps(sphere.center.y), cz = _mm_set1_ps(sphere.center.z);
+    __m128 negRadius = _mm_set1_ps(-sphere.radius);
+    for (int i = 0; i < 8; i += 4) {
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_load_ps(nx + i)), _mm_mul_ps(cy, _mm_load_ps(ny + i))),
+            _mm_add_ps(_mm_mul_ps(cz, _mm_load_ps(nz + i)), _mm_load_ps(nd + i)));
+        if (_mm_movemask_ps(_mm_cmplt_ps(dist, negRadius)) != 0)
+            return false;
+    }
+    return true;
+#else
+    for (int i = 0; i < 6; i++) {
+        float dist = sphere.center.x * nx[i] + sphere.center.y * ny[i] + sphere.center.z * nz[i] + nd[i];
+        if (dist < -sphere.radius)
+            return false;
+    }
+    return true;
+#endif
+}
+
+bool JklFrustum::testBounds(const JklAabb& box, const JklSphere& sphere, const glm::mat4& transform) const {
+    if (sphere.valid() && !testSphere(sphere.transformed(transform)))
+        return false;
+    return testAabb(box.transformed(transform));
+}
@@ -1,22 +1,112 @@
 #include "include/engineinit.hpp"
 #include "include/graphics.hpp"
+#include "include/streaming.hpp"
+#include "include/jobs.hpp"
+#include "include/log.hpp"
+#include "include/profiler.hpp"
+#include "include/input.hpp"
+#include "include/arena.hpp"
+#include "include/memtrack.hpp"
+
+#include <atomic>
+#include <cmath>
 
 int countywounty = 0;
 int inputdir = -1;
 int buttontec;
 
 extern int LastThingDrawn;
+thread_local unsigned int LastTextureBound = 0;
 float deltaTime = 0.0f;
+float jklTickRate = 60.0f;
+float jklFixedDeltaTime = 1.0f / 60.0f;
+float jklRenderAlpha = 0.0f;
+unsigned long long jklTickCount = 0;
+int jklMaxTicksPerFrame = 8;
 
 GLFWwindow* window;
+GLFWwindow* uploadWindow = NULL;
+bool jklUploadThread = false;
+bool jklRenderThread = false;
+int jklFrameBuffers = 2;
+bool jklHeadless = false;
+int jklHeadlessFrames = 600;
+static GLuint headlessFramebuffer = 0;
+static GLuint headlessRenderbuffers[2] = {0, 0};
+// framebuffer size from the resize callback, width in the high half and height in the low, zero
+// when there is nothing new. Events arrive on the main thread but the context may live on the
+// render thread, so the viewport is set there at the start of the next frame
+static std::atomic<unsigned long long> pendingViewport(0);
 JklScene* CurrentScene;
 Shader  *MODELSHADER;
 
+static void tickInput(void);
 
-void jklstart(unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT) {
+// software rasterizer friendly context APIs first, the native one as a last resort. The hint that
+// worked stays set so the upload context is created the same way
+static GLFWwindow* createHeadlessWindow(unsigned int width, unsigned int height) {
+    GLFWwindow* created = NULL;
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_OSMESA_CONTEXT_API
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    created = glfwCreateWindow(width, height, "jackal_engine", NULL, NULL);
+#endif
+#ifdef GLFW_EGL_CONTEXT_API
+    if (created == NULL) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+        created = glfwCreateWindow(width, height, "jackal_engine", NULL, NULL);
+    }
+#endif
+#ifdef GLFW_NATIVE_CONTEXT_API
+    if (created == NULL)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+#endif
+    if (created == NULL)
+        created = glfwCreateWindow(width, height, "jackal_engine", NULL, NULL);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    return created;
+}
+
+// stands in for the default framebuffer, which an invisible or surfaceless window may not have
+static void createHeadlessFramebuffer(unsigned int width, unsigned int height) {
+    glGenFramebuffers(1, &headlessFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, headlessFramebuffer);
+    glGenRenderbuffers(2, headlessRenderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, headlessRenderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessRenderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, headlessRenderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, headlessRenderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        JKL_ERROR(ELOG_ENGINE, "ERROR::ENGINE::HEADLESS_FRAMEBUFFER_INCOMPLETE");
+    glViewport(0, 0, width, height);
+}
+
+
+// logs why the engine can't start and undoes what jklstart set up, jklstart then returns false
+static bool failStart(const char* error) {
+    JKL_ERROR(ELOG_ENGINE, "%s", error);
+    if (window != NULL)
+        glfwDestroyWindow(window);
+    window = NULL;
+    glfwTerminate();
+    jkllogStop();
+    return false;
+}
+
+bool jklstart(unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT) {
+    // console output leaves the frame loop from here on
+    jkllogStart();
         // glfw: initialize and configure
     // ------------------------------
-    glfwInit();
+#ifdef GLFW_PLATFORM_NULL
+    // no display connection at all, only OSMesa contexts work on the null platform
+    if (jklHeadless)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    if (!glfwInit())
+        return failStart("ERROR::ENGINE::GLFW_INIT_FAILED");
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -27,69 +117,234 @@ void jklstart(unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT) {
 
     // glfw window creation
     // --------------------
-    window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "jackal_engine", NULL, NULL);
+    if (jklHeadless)
+        window = createHeadlessWindow(SCR_WIDTH, SCR_HEIGHT);
+    else
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "jackal_engine", NULL, NULL);
     if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-    }
+        return failStart(jklHeadless ? "ERROR::ENGINE::NO_CONTEXT: no headless GL 3.3 context (OSMesa, EGL or native)"
+            : "ERROR::ENGINE::NO_WINDOW: Failed to create GLFW window");
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+        return failStart("ERROR::ENGINE::GLAD_FAILED: Failed to initialize GLAD");
+    jklGpuContextAlive = true;
+    if (jklHeadless) {
+        createHeadlessFramebuffer(SCR_WIDTH, SCR_HEIGHT);
+        JKL_INFO(ELOG_ENGINE, "headless on %s, %d frames", (const char*)glGetString(GL_RENDERER), jklHeadlessFrames);
     }
 
     glEnable(GL_DEPTH_TEST);
     MODELSHADER = new Shader("resources/texflat.vs","resources/texflat.fs");
+
+    // hidden window whose context shares objects with the main one, owned by the streaming upload thread
+    if (jklUploadThread) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        uploadWindow = glfwCreateWindow(1, 1, "jackal_upload", NULL, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (uploadWindow == NULL)
+            JKL_WARN(ELOG_ENGINE, "Failed to create upload context, uploading on the render thread");
+    }
+
+    // the calling thread is worker 0, it runs jobs whenever it waits on them. Texture decodes run
+    // as jobs and the loaders mostly wait on files and decodes, so a quarter of the cores go to
+    // loaders and the job threads take the rest
+    int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+    int loaders = std::min(std::max(cores / 4, 1), 4);
+    jkljobStart(std::max(cores - 1 - loaders, 1));
+    jklstreamStart(loaders, uploadWindow);
+    return true;
 }
  
 void jklsetScene(JklScene* nscene) {
     CurrentScene = nscene;
+    JKL_MEM_TAG(EMEM_SCENE);
     CurrentScene->codeInit();
 }
 
+// draws one recorded frame, on whichever thread owns the GL context
+static void renderFrame(const JklFrame& frame) {
+    JKL_PROFILE_SCOPE("renderFrame");
+    static int frames = 0;
+    static auto start = std::chrono::steady_clock::now();
+    static unsigned long long heapAtStart = jklHeapAllocations();
+
+    unsigned long long viewport = pendingViewport.exchange(0, std::memory_order_relaxed);
+    if (viewport != 0)
+        glViewport(0, 0, (GLsizei)(viewport >> 32), (GLsizei)(viewport & 0xffffffffu));
+
+    LastThingDrawn = -1;
+    glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
+
+    ++frames;
+    auto now = std::chrono::steady_clock::now();
+    auto diff = now - start;
+    if(diff >= std::chrono::seconds(1))
+    {
+        start = now;
+        JKL_INFO(ELOG_RENDER, "FPS: %d (visible %d, culled %d, occluded %d)", frames, jklCullStats.visible, jklCullStats.culled, jklCullStats.occluded);
+        // every thread's heap traffic over the second, it should settle at zero once loading is done
+        if (jklHeapCounting()) {
+            unsigned long long heap = jklHeapAllocations();
+            JKL_INFO(ELOG_MEMORY, "heap allocations per frame: %.1f", (double)(heap - heapAtStart) / frames);
+            heapAtStart = heap;
+        }
+        frames = 0;
+    }
+
+    {
+        JKL_PROFILE_SCOPE("streamPump");
+        jklstreamPump();
+    }
+
+    LastTextureBound = 0;
+    jklCullStats = JklCullStats();
+    {
+        JKL_PROFILE_SCOPE("submit");
+        JKL_GPU_SCOPE("frame");
+        frame.execute();
+    }
+    jklstreamEndFrame();
+
+    {
+        JKL_PROFILE_SCOPE("swap");
+        // nothing to present, but the frame's GPU work should still count against it
+        if (jklHeadless)
+            glFinish();
+        else
+            glfwSwapBuffers(window);
+    }
+    jklmemEndFrame();
+    jklprofileEndFrame();
+    jklarenaResetFrame();
+}
+
+static void renderMain(JklFramePipeline* pipeline) {
+    jklprofileThreadName("render");
+    glfwMakeContextCurrent(window);
+    while (const JklFrame* frame = pipeline->acquireFrame()) {
+        renderFrame(*frame);
+        pipeline->releaseFrame();
+    }
+    glfwMakeContextCurrent(NULL);
+}
+
 void jklrun(void) {
-    int frames = 0;
     deltaTime = 0.0f;
-    float lastFrame = 0.0f;
-    auto start = std::chrono::steady_clock::now();
+    jklFixedDeltaTime = 1.0f / jklTickRate;
+    // doubles, a float clock loses tick precision after a few hours
+    double lastFrame = glfwGetTime();
+    double accumulator = 0.0;
+    int headlessFrames = 0;
+    jklprofileThreadName("game");
+
+    JklFramePipeline pipeline(jklFrameBuffers);
+    std::thread renderer;
+    if (jklRenderThread) {
+        // the context moves to the render thread, events stay here as GLFW requires
+        glfwMakeContextCurrent(NULL);
+        renderer = std::thread(renderMain, &pipeline);
+    }
+
     while (!glfwWindowShouldClose(window))
     {
-        LastThingDrawn = -1;
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
+        JKL_PROFILE_SCOPE("frame");
+        double currentFrame = glfwGetTime();
+        double frameTime = currentFrame - lastFrame;
+        if (jklHeadless)
+            frameTime = jklFixedDeltaTime;
+        deltaTime = static_cast<float>(frameTime);
         lastFrame = currentFrame;
-		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
-
-        ++frames;
-        auto now = std::chrono::steady_clock::now();
-        auto diff = now - start;
-        auto end = now + std::chrono::milliseconds(16);
-        if(diff >= std::chrono::seconds(1))
         {
-            start = now;
-            std::cout << "FPS: " << frames << std::endl;
-            frames = 0;
+            JKL_PROFILE_SCOPE("processInput");
+            processInput(window);
         }
-        processInput(window);
-
 
-        CurrentScene->codeLoop();
+        accumulator += frameTime;
+        int ticks = 0;
+        while (accumulator >= jklFixedDeltaTime) {
+            if (ticks == jklMaxTicksPerFrame) {
+                accumulator = std::fmod(accumulator, (double)jklFixedDeltaTime);
+                break;
+            }
+            JKL_PROFILE_SCOPE("tick");
+            tickInput();
+            {
+                JKL_MEM_TAG(EMEM_SCENE);
+                CurrentScene->codeTick();
+            }
+            jklTickCount++;
+            accumulator -= jklFixedDeltaTime;
+            ticks++;
+        }
+        jklRenderAlpha = static_cast<float>(accumulator / jklFixedDeltaTime);
 
-        glfwSwapBuffers(window);
+        // blocks while the render thread is jklFrameBuffers frames behind
+        JklFrame* next;
+        {
+            JKL_PROFILE_SCOPE("waitFrame");
+            next = &pipeline.beginFrame();
+        }
+        JklFrame& frame = *next;
+        frame.tick = jklTickCount;
+        {
+            JKL_PROFILE_SCOPE("codeFrame");
+            JKL_MEM_TAG(EMEM_SCENE);
+            CurrentScene->codeFrame(frame);
+        }
+        if (jklRenderThread)
+            pipeline.submitFrame();
+        else
+            renderFrame(frame);
 
         glfwPollEvents();
+        jklarenaResetFrame();
+        if (jklHeadless && ++headlessFrames >= jklHeadlessFrames)
+            glfwSetWindowShouldClose(window, true);
 
 
     };
+
+    if (jklRenderThread) {
+        // a headless run counts drawn frames, let the render thread catch up
+        if (jklHeadless)
+            pipeline.finish();
+        pipeline.stop();
+        renderer.join();
+        glfwMakeContextCurrent(window);
+    }
+
+    jklinputStop();
+    jklstreamStop();
+    if (jklprofileCapturing())
+        jklprofileEndCapture("jackal_trace.json");
+    jklprofileReport();
+    jklprofileShutdown();
+    jklmemReport();
+    jkljobReport();
+    jkljobStop();
+    if (headlessFramebuffer) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(2, headlessRenderbuffers);
+        glDeleteFramebuffers(1, &headlessFramebuffer);
+        headlessFramebuffer = 0;
+    }
+    jklGpuReport();
+    jklReportMemory("exit");
+    // objects still alive past this point are reclaimed with the context
+    jklGpuContextAlive = false;
+    if (jkllogDropped() > 0)
+        JKL_WARN(ELOG_ENGINE, "%llu log records dropped, the ring was full", jkllogDropped());
+    jkllogStop();
 };
 
 
@@ -98,29 +353,34 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    bool inputbools[5];
-    for(int i = 0; i < 5; i++) {
-        inputbools[i] = false;
-    };
+    // F9 starts a profiler capture and writes it out when pressed again, see profiler.hpp
+    static bool captureKey = false;
+    bool captureDown = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+    if (captureDown && !captureKey) {
+        if (jklprofileCapturing())
+            jklprofileEndCapture("jackal_trace.json");
+        else
+            jklprofileBeginCapture();
+    }
+    captureKey = captureDown;
 
-    inputdir = -1;
+    // gameplay keys arrive as events through key_callback, see input.hpp
+ }
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) inputbools[0] = true;
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) inputbools[1] = true;
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) inputbools[2] = true;
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) inputbools[3] = true;
-    if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) inputbools[4] = true;
+// the button counter counts ticks, not frames
+static void tickInput(void)
+{
+    bool wasReplaying = jklinputReplaying();
+    JklInputSnapshot input = jklinputTick(jklinputConsume());
+    if (wasReplaying && !jklinputReplaying() && jklReplayExit)
+        glfwSetWindowShouldClose(window, true);
 
-    if(inputbools[0] == true) inputdir = 0; // up
-    if(inputbools[1] == true) inputdir = 2; // right
-    if(inputbools[2] == true) inputdir = 4; // down
-    if(inputbools[3] == true) inputdir = 6; // left
+    // inputdir for every up/right/down/left combination: 0 up, 2 right, 4 down, 6 left, odd ones
+    // diagonal, -1 none. Opposite directions resolve the way the old chain of ifs did
+    static const int directions[16] = {-1, 0, 2, 1, 4, 4, 3, 3, 6, 7, 6, 7, 5, 7, 5, 7};
+    inputdir = directions[input.buttons & (EINPUT_UP | EINPUT_RIGHT | EINPUT_DOWN | EINPUT_LEFT)];
 
-    if(inputbools[0] == true && inputbools[1] == true) inputdir = 1;
-    if(inputbools[1] == true && inputbools[2] == true) inputdir = 3;
-    if(inputbools[2] == true && inputbools[3] == true) inputdir = 5;
-    if(inputbools[3] == true && inputbools[0] == true) inputdir = 7;
-    if(inputbools[4] == true && buttontec != 2) {
+    if(input.held(EINPUT_ACTION) && buttontec != 2) {
         buttontec = 1;
     };
 
@@ -132,37 +392,36 @@ void processInput(GLFWwindow *window)
         buttontec = 0;
         countywounty = 0;
     }
-    std::cout << "counter : " << countywounty << std::endl;
+    JKL_TRACE(ELOG_INPUT, "counter : %d", countywounty);
  }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    // minimizing reports 0x0, keep the last viewport rather than queue an empty one
+    if (width <= 0 || height <= 0)
+        return;
+    pendingViewport.store(((unsigned long long)width << 32) | (unsigned int)height, std::memory_order_relaxed);
 }
 
 
+// the callbacks only queue events, the tick consumes them. Cursor movement reaches codeTick as
+// the snapshot's lookX/lookY, scrolling as its scroll, for camera.ProcessMouseMovement and friends
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
-//    float xpos = static_cast<float>(xposIn);
-//    float ypos = static_cast<float>(yposIn);
-//
-//    if (firstMouse)
-//    {
-//        lastX = xpos;
-//        lastY = ypos;
-//        firstMouse = false;
-//    }
-//
-//    float xoffset = xpos - lastX;
-//    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
-//
-//    lastX = xpos;
-//    lastY = ypos;
-//
-   // camera.ProcessMouseMovement(xoffset, yoffset);
+    jklinputPushEvent({EINPUT_CURSOR, 0, 0, xposIn, yposIn});
 }
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-   // camera.ProcessMouseScroll(static_cast<float>(yoffset));
-}
\ No newline at end of file
+    jklinputPushEvent({EINPUT_SCROLL, 0, 0, xoffset, yoffset});
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    jklinputPushEvent({EINPUT_KEY, key, action, 0.0, 0.0});
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    jklinputPushEvent({EINPUT_MOUSE_BUTTON, button, action, 0.0, 0.0});
+}
@@ -0,0 +1,133 @@
+#include <glad/glad.h>
+#include "include/gpuresources.hpp"
+#include "include/log.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#ifdef _WIN32
+#include "include/mingw.mutex.h"
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+#ifdef __linux__
+#include <mutex>
+#endif
+
+bool jklGpuContextAlive = false;
+bool jklKeepCpuGeometry = true;
+
+static std::atomic<long long> liveBytes[EGPU_RESOURCE_COUNT];
+static std::unordered_map<unsigned int, size_t> textureBytes;
+static std::mutex textureMutex;
+
+void jklGpuTrack(EGPU_RESOURCE type, long long bytes) {
+    liveBytes[type].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+long long jklGpuBytes(EGPU_RESOURCE type) {
+    return liveBytes[type].load(std::memory_order_relaxed);
+}
+
+long long jklGpuTotalBytes(void) {
+    long long total = 0;
+    for (int i = 0; i < EGPU_RESOURCE_COUNT; i++)
+        total += jklGpuBytes((EGPU_RESOURCE)i);
+    return total;
+}
+
+const char* jklGpuResourceName(EGPU_RESOURCE type) {
+    switch (type) {
+        case EGPU_MESH: return "mesh";
+        case EGPU_STATICMESH: return "staticmesh";
+        case EGPU_TEXTURE: return "texture";
+        default: return "unknown";
+    }
+}
+
+// textures are created on the render and upload threads alike
+void jklGpuRegisterTexture(unsigned int texture, size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(textureMutex);
+        textureBytes[texture] = bytes;
+    }
+    jklGpuTrack(EGPU_TEXTURE, (long long)bytes);
+}
+
+void jklDeleteTexture(unsigned int texture) {
+    if (texture == 0)
+        return;
+    size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(textureMutex);
+        auto found = textureBytes.find(texture);
+        if (found != textureBytes.end()) {
+            bytes = found->second;
+            textureBytes.erase(found);
+        }
+    }
+    jklGpuTrack(EGPU_TEXTURE, -(long long)bytes);
+    if (jklGpuContextAlive)
+        glDeleteTextures(1, &texture);
+}
+
+void jklGpuReport(void) {
+    std::string line = "GPU memory :";
+    for (int i = 0; i < EGPU_RESOURCE_COUNT; i++)
+        line += " " + std::string(jklGpuResourceName((EGPU_RESOURCE)i)) + " " + std::to_string(jklGpuBytes((EGPU_RESOURCE)i) / 1024) + " KB";
+    JKL_INFO(ELOG_MEMORY, "%s, total %lld KB", line.c_str(), (long long)(jklGpuTotalBytes() / 1024));
+}
+
+#ifdef __linux__
+// reads a "Name:   1234 kB" line of /proc/self/status
+static size_t procStatusBytes(const char* field) {
+    FILE* status = fopen("/proc/self/status", "r");
+    if (!status)
+        return 0;
+    char line[256];
+    size_t kb = 0;
+    size_t length = strlen(field);
+    while (fgets(line, sizeof(line), status)) {
+        if (strncmp(line, field, length) == 0 && line[length] == ':') {
+            sscanf(line + length + 1, "%zu", &kb);
+            break;
+        }
+    }
+    fclose(status);
+    return kb * 1024;
+}
+#endif
+
+size_t jklProcessRss(void) {
+#ifdef __linux__
+    return procStatusBytes("VmRSS");
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize;
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+size_t jklProcessPeakRss(void) {
+#ifdef __linux__
+    return procStatusBytes("VmHWM");
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+void jklReportMemory(const char* label) {
+    JKL_INFO(ELOG_MEMORY, "Memory (%s) : rss %llu KB, peak %llu KB", label,
+        (unsigned long long)(jklProcessRss() / 1024), (unsigned long long)(jklProcessPeakRss() / 1024));
+}
@@ -0,0 +1,608 @@
+#include "include/images.hpp"
+#include "include/jobs.hpp"
+#include "include/log.hpp"
+#include "include/memtrack.hpp"
+
+// stb_image takes every allocation, decode scratch included, from the staging pool
+#define STBI_MALLOC(size)               jklStagingAlloc(size)
+#define STBI_REALLOC(block, size)       jklStagingRealloc(block, size)
+#define STBI_FREE(block)                jklStagingFree(block)
+#define STB_IMAGE_IMPLEMENTATION
+#include "include/stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+JklImage& JklImage::operator=(JklImage&& other) {
+    if (this != &other) {
+        release();
+        width = other.width;
+        height = other.height;
+        channels = other.channels;
+        data = other.data;
+        mipData = std::move(other.mipData);
+        mipOffsets = std::move(other.mipOffsets);
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+void JklImage::release(void) {
+    if (data)
+        stbi_image_free(data);
+    data = nullptr;
+    mipData.clear();
+    mipData.shrink_to_fit();
+    mipOffsets.clear();
+}
+
+
+// ------------------------------------------------------------------------
+// staging pool
+
+// every block is preceded by a header holding its size class, 16 bytes keeps the payload aligned
+struct StagingHeader {
+    uint32_t sizeClass;
+    uint32_t pad[3];
+};
+
+static const int STAGING_MIN_SHIFT = 12;   // 4 KB
+static const int STAGING_MAX_SHIFT = 26;   // 64 MB
+static const int STAGING_CLASSES = STAGING_MAX_SHIFT - STAGING_MIN_SHIFT + 1;
+static const uint32_t STAGING_UNPOOLED = 0xffffffff;
+static const size_t STAGING_KEEP_PER_CLASS = 8;
+
+static std::mutex stagingMutex;
+static std::vector<StagingHeader*> stagingFree[STAGING_CLASSES];
+static size_t stagingPooled = 0;
+
+static size_t stagingCapacity(uint32_t sizeClass) {
+    return (size_t)1 << (sizeClass + STAGING_MIN_SHIFT);
+}
+
+void* jklStagingAlloc(size_t size) {
+    uint32_t sizeClass = 0;
+    while (sizeClass < STAGING_CLASSES && stagingCapacity(sizeClass) < size)
+        sizeClass++;
+
+    StagingHeader* header = nullptr;
+    if (sizeClass >= STAGING_CLASSES) {
+        header = (StagingHeader*)malloc(sizeof(StagingHeader) + size);
+        if (!header)
+            return nullptr;
+        header->sizeClass = STAGING_UNPOOLED;
+        return header + 1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(stagingMutex);
+        if (!stagingFree[sizeClass].empty()) {
+            header = stagingFree[sizeClass].back();
+            stagingFree[sizeClass].pop_back();
+            stagingPooled -= stagingCapacity(sizeClass);
+        }
+    }
+    if (!header) {
+        header = (StagingHeader*)malloc(sizeof(StagingHeader) + stagingCapacity(sizeClass));
+        if (!header)
+            return nullptr;
+        header->sizeClass = sizeClass;
+    }
+    return header + 1;
+}
+
+void jklStagingFree(void* block) {
+    if (!block)
+        return;
+    StagingHeader* header = (StagingHeader*)block - 1;
+    if (header->sizeClass != STAGING_UNPOOLED) {
+        std::lock_guard<std::mutex> lock(stagingMutex);
+        if (stagingFree[header->sizeClass].size() < STAGING_KEEP_PER_CLASS) {
+            stagingFree[header->sizeClass].push_back(header);
+            stagingPooled += stagingCapacity(header->sizeClass);
+            return;
+        }
+    }
+    free(header);
+}
+
+void* jklStagingRealloc(void* block, size_t size) {
+    if (!block)
+        return jklStagingAlloc(size);
+    StagingHeader* header = (StagingHeader*)block - 1;
+    if (header->sizeClass == STAGING_UNPOOLED) {
+        StagingHeader* grown = (StagingHeader*)realloc(header, sizeof(StagingHeader) + size);
+        return grown ? grown + 1 : nullptr;
+    }
+    size_t capacity = stagingCapacity(header->sizeClass);
+    if (size <= capacity)
+        return block;
+    void* grown = jklStagingAlloc(size);
+    if (grown) {
+        memcpy(grown, block, capacity);
+        jklStagingFree(block);
+    }
+    return grown;
+}
+
+size_t jklStagingPooledBytes(void) {
+    std::lock_guard<std::mutex> lock(stagingMutex);
+    return stagingPooled;
+}
+
+
+// ------------------------------------------------------------------------
+// decoding
+
+int jklUploadChannels(int fileChannels) {
+    return fileChannels == 3 ? 4 : fileChannels;
+}
+
+bool jklDecodeImage(const char* path, JklImage& image, int forceChannels) {
+    image.release();
+    int fileChannels;
+    if (forceChannels < 0) {
+        int w, h;
+        forceChannels = stbi_info(path, &w, &h, &fileChannels) ? jklUploadChannels(fileChannels) : 0;
+    }
+    image.data = stbi_load(path, &image.width, &image.height, &fileChannels, forceChannels);
+    if (!image.data) {
+        JKL_ERROR(ELOG_ASSET, "Texture failed to load at path: %s (%s)", path, stbi_failure_reason());
+        return false;
+    }
+    image.channels = forceChannels ? forceChannels : fileChannels;
+    return true;
+}
+
+void jklBuildMipChain(JklImage& image) {
+    if (!image.data || image.levels() > 1)
+        return;
+
+    int c = image.channels;
+    size_t total = 0;
+    int levels = 1;
+    for (int w = image.width, h = image.height; w > 1 || h > 1; levels++) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+        total += (size_t)w * h * c;
+    }
+    image.mipData.resize(total);
+    image.mipOffsets.reserve(levels - 1);
+
+    size_t offset = 0;
+    for (int level = 1; level < levels; level++) {
+        image.mipOffsets.push_back(offset);
+        const unsigned char* src = image.levelData(level - 1);
+        int sw = image.levelWidth(level - 1), sh = image.levelHeight(level - 1);
+        int dw = image.levelWidth(level), dh = image.levelHeight(level);
+        unsigned char* dst = &image.mipData[offset];
+        for (int y = 0; y < dh; y++) {
+            int y0 = y * 2, y1 = y0 + 1 < sh ? y0 + 1 : y0;
+            for (int x = 0; x < dw; x++) {
+                int x0 = x * 2, x1 = x0 + 1 < sw ? x0 + 1 : x0;
+                for (int k = 0; k < c; k++) {
+                    int sum = src[(y0 * sw + x0) * c + k] + src[(y0 * sw + x1) * c + k]
+                            + src[(y1 * sw + x0) * c + k] + src[(y1 * sw + x1) * c + k];
+                    dst[(y * dw + x) * c + k] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        offset += image.levelBytes(level);
+    }
+}
+
+
+JklDecodePool::JklDecodePool(int threads) {
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(&JklDecodePool::workerMain, this);
+}
+
+JklDecodePool::~JklDecodePool(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    signal.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void JklDecodePool::workerMain(void) {
+    for (;;) {
+        std::function<void(void)> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            signal.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+std::future<JklImage> JklDecodePool::decode(const std::string& path, int forceChannels, bool mips) {
+    auto promise = std::make_shared<std::promise<JklImage>>();
+    std::future<JklImage> result = promise->get_future();
+    auto job = [promise, path, forceChannels, mips] {
+        JKL_MEM_TAG(EMEM_TEXTURE);
+        JklImage image;
+        if (jklDecodeImage(path.c_str(), image, forceChannels) && mips)
+            jklBuildMipChain(image);
+        promise->set_value(std::move(image));
+    };
+    if (workers.empty()) {
+        jkljobRun(job);
+        return result;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    signal.notify_one();
+    return result;
+}
+
+JklDecodePool& jklDecodePool(void) {
+    static JklDecodePool pool;
+    return pool;
+}
+
+
+// ------------------------------------------------------------------------
+// BC1 / BC3 block codecs
+
+static uint16_t packRGB565(const float c[3]) {
+    int r = (int)(c[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(c[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+    r = r < 0 ? 0 : (r > 31 ? 31 : r);
+    g = g < 0 ? 0 : (g > 63 ? 63 : g);
+    b = b < 0 ? 0 : (b > 31 ? 31 : b);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t c, int out[3]) {
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// endpoints are the extremes of the block's colours projected on their principal axis
+static void encodeColorBlock(const unsigned char px[16][4], unsigned char out[8]) {
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int k = 0; k < 3; k++)
+            mean[k] += px[i][k] / 16.0f;
+
+    float cov[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        float r = px[i][0] - mean[0], g = px[i][1] - mean[1], b = px[i][2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    float axis[3] = {1, 1, 1};
+    for (int iter = 0; iter < 4; iter++) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float m = std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+        if (m == 0.0f)
+            break;
+        axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+    }
+
+    float lo = 1e30f, hi = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float d = (px[i][0] - mean[0]) * axis[0] + (px[i][1] - mean[1]) * axis[1] + (px[i][2] - mean[2]) * axis[2];
+        lo = std::min(lo, d);
+        hi = std::max(hi, d);
+    }
+    float len2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float maxc[3], minc[3];
+    for (int k = 0; k < 3; k++) {
+        maxc[k] = mean[k] + axis[k] * hi / (len2 > 0 ? len2 : 1);
+        minc[k] = mean[k] + axis[k] * lo / (len2 > 0 ? len2 : 1);
+    }
+
+    uint16_t c0 = packRGB565(maxc), c1 = packRGB565(minc);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        // c0 > c1 selects the four colour mode
+        int p[4][3];
+        unpackRGB565(c0, p[0]);
+        unpackRGB565(c1, p[1]);
+        for (int k = 0; k < 3; k++) {
+            p[2][k] = (2 * p[0][k] + p[1][k]) / 3;
+            p[3][k] = (p[0][k] + 2 * p[1][k]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDist = 1 << 30;
+            for (int j = 0; j < 4; j++) {
+                int dr = px[i][0] - p[j][0], dg = px[i][1] - p[j][1], db = px[i][2] - p[j][2];
+                int dist = dr * dr + dg * dg + db * db;
+                if (dist < bestDist) { bestDist = dist; best = j; }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+    out[0] = c0 & 0xff; out[1] = c0 >> 8;
+    out[2] = c1 & 0xff; out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+static void encodeAlphaBlock(const unsigned char px[16][4], unsigned char out[8]) {
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, (int)px[i][3]);
+        a1 = std::min(a1, (int)px[i][3]);
+    }
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        // a0 > a1 selects the eight alpha mode
+        int p[8] = {a0, a1};
+        for (int j = 1; j < 7; j++)
+            p[j + 1] = ((7 - j) * a0 + j * a1) / 7;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDist = 1 << 30;
+            for (int j = 0; j < 8; j++) {
+                int dist = std::abs(px[i][3] - p[j]);
+                if (dist < bestDist) { bestDist = dist; best = j; }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+static void decodeColorBlock(const unsigned char in[8], unsigned char px[16][4]) {
+    uint16_t c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+    int p[4][4];
+    unpackRGB565(c0, p[0]);
+    unpackRGB565(c1, p[1]);
+    p[0][3] = p[1][3] = p[2][3] = 255;
+    for (int k = 0; k < 3; k++) {
+        if (c0 > c1) {
+            p[2][k] = (2 * p[0][k] + p[1][k]) / 3;
+            p[3][k] = (p[0][k] + 2 * p[1][k]) / 3;
+        } else {
+            p[2][k] = (p[0][k] + p[1][k]) / 2;
+            p[3][k] = 0;
+        }
+    }
+    p[3][3] = c0 > c1 ? 255 : 0;
+    uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+    for (int i = 0; i < 16; i++) {
+        int j = (indices >> (2 * i)) & 3;
+        for (int k = 0; k < 4; k++)
+            px[i][k] = (unsigned char)p[j][k];
+    }
+}
+
+static void decodeAlphaBlock(const unsigned char in[8], unsigned char px[16][4]) {
+    int p[8] = {in[0], in[1]};
+    if (p[0] > p[1]) {
+        for (int j = 1; j < 7; j++)
+            p[j + 1] = ((7 - j) * p[0] + j * p[1]) / 7;
+    } else {
+        for (int j = 1; j < 5; j++)
+            p[j + 1] = ((5 - j) * p[0] + j * p[1]) / 5;
+        p[6] = 0;
+        p[7] = 255;
+    }
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++)
+        indices |= (uint64_t)in[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++)
+        px[i][3] = (unsigned char)p[(indices >> (3 * i)) & 7];
+}
+
+size_t jklBlockCompressedSize(EJKT_FORMAT format, int width, int height) {
+    size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (format == EJKT_BC1 ? 8 : 16);
+}
+
+void jklCompressBlocks(EJKT_FORMAT format, const unsigned char* rgba, int width, int height, unsigned char* out) {
+    unsigned char px[16][4];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            // edge blocks replicate the last row/column
+            for (int i = 0; i < 16; i++) {
+                int x = std::min(bx + (i & 3), width - 1);
+                int y = std::min(by + (i >> 2), height - 1);
+                memcpy(px[i], rgba + ((size_t)y * width + x) * 4, 4);
+            }
+            if (format == EJKT_BC3) {
+                encodeAlphaBlock(px, out);
+                out += 8;
+            }
+            encodeColorBlock(px, out);
+            out += 8;
+        }
+    }
+}
+
+void jklDecompressBlocks(EJKT_FORMAT format, const unsigned char* blocks, int width, int height, unsigned char* rgba) {
+    unsigned char px[16][4];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            const unsigned char* alpha = nullptr;
+            if (format == EJKT_BC3) {
+                alpha = blocks;
+                blocks += 8;
+            }
+            decodeColorBlock(blocks, px);
+            blocks += 8;
+            if (alpha)
+                decodeAlphaBlock(alpha, px);
+            for (int i = 0; i < 16; i++) {
+                int x = bx + (i & 3), y = by + (i >> 2);
+                if (x < width && y < height)
+                    memcpy(rgba + ((size_t)y * width + x) * 4, px[i], 4);
+            }
+        }
+    }
+}
+
+
+// ------------------------------------------------------------------------
+// .jkt container
+
+void jklCookImage(const JklImage& image, EJKT_FORMAT format, JklCookedTexture& out) {
+    out.format = format;
+    out.width = image.width;
+    out.height = image.height;
+    out.data.clear();
+    out.offsets.clear();
+    out.sizes.clear();
+
+    std::vector<unsigned char> rgba;
+    for (int level = 0; level < image.levels(); level++) {
+        int w = image.levelWidth(level), h = image.levelHeight(level);
+        const unsigned char* src = image.levelData(level);
+        size_t offset = out.data.size();
+
+        if (format == EJKT_BC1 || format == EJKT_BC3) {
+            // the block codecs want RGBA8 whatever the source had
+            rgba.resize((size_t)w * h * 4);
+            for (size_t i = 0; i < (size_t)w * h; i++) {
+                const unsigned char* s = src + i * image.channels;
+                unsigned char* d = &rgba[i * 4];
+                d[0] = s[0];
+                d[1] = image.channels > 2 ? s[1] : s[0];
+                d[2] = image.channels > 2 ? s[2] : s[0];
+                d[3] = image.channels == 4 ? s[3] : (image.channels == 2 ? s[1] : 255);
+            }
+            size_t size = jklBlockCompressedSize(format, w, h);
+            out.data.resize(offset + size);
+            jklCompressBlocks(format, rgba.data(), w, h, &out.data[offset]);
+        } else {
+            size_t size = image.levelBytes(level);
+            out.data.insert(out.data.end(), src, src + size);
+        }
+        out.offsets.push_back(offset);
+        out.sizes.push_back(out.data.size() - offset);
+    }
+}
+
+size_t jklCookedLevelBytes(uint32_t format, int width, int height) {
+    switch (format) {
+        case EJKT_R8:
+        case EJKT_RG8:
+        case EJKT_RGB8:
+        case EJKT_RGBA8:
+            return (size_t)width * height * (format - EJKT_R8 + 1);
+        case EJKT_BC1:
+        case EJKT_BC3:
+            return jklBlockCompressedSize((EJKT_FORMAT)format, width, height);
+        default:
+            return 0;
+    }
+}
+
+// largest side a cooked texture may have, GL 3.3 only guarantees 1024 but no driver stops there
+static const uint32_t JKT_MAX_SIZE = 1u << 15;
+
+// a full chain ends at 1x1, one more level would be the same size again
+static int maxLevels(uint32_t width, uint32_t height) {
+    int levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+bool jklValidCookedTexture(const JklCookedTexture& texture) {
+    if (texture.width == 0 || texture.height == 0 || texture.width > JKT_MAX_SIZE || texture.height > JKT_MAX_SIZE)
+        return false;
+    if (texture.levels() == 0 || texture.levels() > maxLevels(texture.width, texture.height) || texture.sizes.size() != texture.offsets.size())
+        return false;
+    for (int level = 0; level < texture.levels(); level++) {
+        size_t expected = jklCookedLevelBytes(texture.format, texture.levelWidth(level), texture.levelHeight(level));
+        if (expected == 0 || texture.sizes[level] != expected || texture.offsets[level] + expected > texture.data.size())
+            return false;
+    }
+    return true;
+}
+
+bool jklReadCookedTexture(const char* path, JklCookedTexture& texture) {
+    texture = JklCookedTexture();
+    std::ifstream infile(path, std::ios::binary);
+    char magic[4];
+    uint32_t header[4];
+    infile.read(magic, 4);
+    infile.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!infile || memcmp(magic, "JKT1", 4) != 0 || jklCookedLevelBytes(header[0], 1, 1) == 0
+        || header[1] == 0 || header[2] == 0 || header[1] > JKT_MAX_SIZE || header[2] > JKT_MAX_SIZE
+        || header[3] == 0 || (int)header[3] > maxLevels(header[1], header[2])) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::JKT::INVALID_FILE: %s", path);
+        return false;
+    }
+    JklCookedTexture read;
+    read.format = header[0];
+    read.width = header[1];
+    read.height = header[2];
+
+    // every level's size follows from the header, anything else is a corrupt or foreign file
+    std::vector<uint32_t> sizes(header[3]);
+    infile.read(reinterpret_cast<char*>(sizes.data()), sizes.size() * sizeof(uint32_t));
+    size_t total = 0;
+    for (uint32_t level = 0; infile && level < header[3]; level++) {
+        if (sizes[level] != jklCookedLevelBytes(read.format, read.levelWidth(level), read.levelHeight(level))) {
+            JKL_ERROR(ELOG_ASSET, "ERROR::JKT::BAD_LEVEL_SIZE: %s", path);
+            return false;
+        }
+        read.offsets.push_back(total);
+        read.sizes.push_back(sizes[level]);
+        total += sizes[level];
+    }
+    if (infile) {
+        read.data.resize(total);
+        infile.read(reinterpret_cast<char*>(read.data.data()), total);
+    }
+    if (!infile) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::JKT::TRUNCATED_FILE: %s", path);
+        return false;
+    }
+    texture = std::move(read);
+    return true;
+}
+
+std::string jklCookedTextureSource(const char* path) {
+    static const char* extensions[] = {".png", ".jpg", ".jpeg", ".tga", ".bmp", ".PNG", ".JPG", ".TGA", ".BMP"};
+    std::string stem(path);
+    size_t dot = stem.find_last_of('.');
+    size_t slash = stem.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        stem.erase(dot);
+    for (const char* extension : extensions) {
+        std::string candidate = stem + extension;
+        if (std::ifstream(candidate, std::ios::binary))
+            return candidate;
+    }
+    return std::string();
+}
+
+bool jklWriteCookedTexture(const char* path, const JklCookedTexture& texture) {
+    std::ofstream outfile(path, std::ios::binary);
+    uint32_t header[4] = {texture.format, texture.width, texture.height, (uint32_t)texture.levels()};
+    outfile.write("JKT1", 4);
+    outfile.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (size_t size : texture.sizes) {
+        uint32_t size32 = (uint32_t)size;
+        outfile.write(reinterpret_cast<const char*>(&size32), sizeof(size32));
+    }
+    outfile.write(reinterpret_cast<const char*>(texture.data.data()), texture.data.size());
+    return (bool)outfile;
+}
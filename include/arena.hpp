@@ -0,0 +1,129 @@
+#ifndef _ARENA_HPP_
+#define _ARENA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Linear allocator for data that only lives for part of a frame. allocate() bumps an offset in
+// the current block, nothing is freed one by one. Every thread has its own frame arena, the
+// engine resets the game and render thread ones at the end of each frame; other threads reset
+// theirs with jklarenaResetFrame or only allocate inside a JklArenaScope.
+//
+// When a frame needs more than the block, another block is taken from the heap, and the next
+// reset replaces them all with one block big enough for the whole frame. After the first few
+// frames a thread's arena never touches the heap again.
+//
+// Arena memory must not outlive the frame or the scope it was allocated in, so nothing handed to
+// another thread (JklFrame data, upload packets) may come from a thread's frame arena. A JklFrame
+// keeps its commands in an arena of its own instead.
+class JklArena {
+public:
+    static const size_t DEFAULT_BLOCK = 64 * 1024;
+
+    explicit JklArena(size_t blockSize = DEFAULT_BLOCK);
+    ~JklArena(void);
+
+    JklArena(const JklArena&) = delete;
+    JklArena& operator=(const JklArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        if (current < blocks.size()) {
+            uintptr_t base = reinterpret_cast<uintptr_t>(blocks[current].data);
+            size_t start = ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+            if (start + bytes <= blocks[current].size) {
+                offset = start + bytes;
+                return blocks[current].data + start;
+            }
+        }
+        return allocateSlow(bytes, alignment);
+    };
+
+    // a point allocations can be rolled back to
+    struct Mark {
+        size_t block;
+        size_t offset;
+    };
+    Mark mark(void) const { return {current, offset}; };
+    void rewind(const Mark& to) {
+        size_t now = used();
+        if (now > peak)
+            peak = now;
+        current = to.block;
+        offset = to.offset;
+    };
+    // frees everything, merging the blocks into one when the frame needed more than one
+    void reset(void);
+
+    size_t capacity(void) const;
+    // bytes handed out since the last reset, alignment padding included
+    size_t used(void) const;
+    // the most that was ever in use at once
+    size_t highWater(void) const { return peak; };
+    // blocks taken from the heap so far
+    unsigned long long heapBlocks(void) const { return blockAllocations; };
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    void* allocateSlow(size_t bytes, size_t alignment);
+
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t offset = 0;
+    size_t blockSize;
+    size_t peak = 0;
+    unsigned long long blockAllocations = 0;
+};
+
+// the calling thread's frame arena
+JklArena& jklFrameArena(void);
+// frees the calling thread's frame arena, at the end of a frame
+void jklarenaResetFrame(void);
+
+// rolls the frame arena back when it goes out of scope. Declare it before the containers using
+// the arena so they are destroyed first; code that may run outside the game and render threads
+// (job workers, tools) uses one so its arena never grows
+struct JklArenaScope {
+    JklArena& arena;
+    JklArena::Mark start;
+
+    JklArenaScope(void) : arena(jklFrameArena()), start(arena.mark()) {};
+    explicit JklArenaScope(JklArena& arena) : arena(arena), start(arena.mark()) {};
+    ~JklArenaScope(void) { arena.rewind(start); };
+
+    JklArenaScope(const JklArenaScope&) = delete;
+    JklArenaScope& operator=(const JklArenaScope&) = delete;
+};
+
+// STL allocator over an arena, the calling thread's frame arena by default. deallocate does
+// nothing, so reserve what is known up front: every regrowth leaves the old buffer behind
+template<typename T>
+struct JklArenaAllocator {
+    typedef T value_type;
+
+    JklArena* arena;
+
+    JklArenaAllocator(void) : arena(&jklFrameArena()) {};
+    explicit JklArenaAllocator(JklArena& arena) : arena(&arena) {};
+    template<typename U>
+    JklArenaAllocator(const JklArenaAllocator<U>& other) : arena(other.arena) {};
+
+    T* allocate(size_t count) { return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T))); };
+    void deallocate(T*, size_t) {};
+};
+
+template<typename T, typename U>
+bool operator==(const JklArenaAllocator<T>& a, const JklArenaAllocator<U>& b) { return a.arena == b.arena; }
+template<typename T, typename U>
+bool operator!=(const JklArenaAllocator<T>& a, const JklArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+template<typename T>
+using JklFrameVector = std::vector<T, JklArenaAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, JklArenaAllocator<char>> JklFrameString;
+
+#endif
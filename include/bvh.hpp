@@ -0,0 +1,67 @@
+#ifndef _BVH_HPP_
+#define _BVH_HPP_
+
+#include "culling.hpp"
+
+#include <functional>
+#include <vector>
+
+// Bounding volume hierarchy over a set of world space boxes, one per object. Built top down with
+// the surface area heuristic evaluated over binned centroids, nodes are stored in one array with
+// children always after their parent so refit() is a single reverse pass.
+//
+// Objects are referred to by their index in the array given to build(). Moving objects only
+// needs update() + refit(), the tree is worth rebuilding once boxes have drifted far from where
+// they were at build time.
+class JklBvh {
+public:
+    static const int LEAF_SIZE = 4;
+    static const int BINS = 16;
+    // deeper nodes become leaves whatever their size, bounds the traversal stacks
+    static const int MAX_DEPTH = 60;
+
+    JklBvh(void) {};
+
+    void build(const std::vector<JklAabb>& boxes);
+    // replaces an object's box, takes effect in the tree after refit()
+    void update(int object, const JklAabb& box) { boxes[object] = box; dirty = true; };
+    // recomputes every node box bottom up from the current object boxes
+    void refit(void);
+
+    // each query appends the objects whose boxes pass to out
+    void queryFrustum(const JklFrustum& frustum, std::vector<int>& out) const;
+    void querySphere(const JklSphere& sphere, std::vector<int>& out) const;
+    void queryAabb(const JklAabb& box, std::vector<int>& out) const;
+    void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<int>& out) const;
+
+    // nearest object along the ray, -1 when nothing is hit. exact, when given, refines the box hit:
+    // it gets the object and the box entry distance and returns false for a miss or a closer t
+    int raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance,
+        const std::function<bool(int object, float& t)>& exact = nullptr) const;
+
+    size_t objectCount(void) const { return boxes.size(); };
+    size_t nodeCount(void) const { return nodes.size(); };
+    const JklAabb& objectBounds(int object) const { return boxes[object]; };
+    JklAabb bounds(void) const { return nodes.empty() ? JklAabb() : nodes[0].box; };
+
+private:
+    struct Node {
+        JklAabb box;
+        int left;       // interior: index of the left child, the right one follows it
+        int first;      // leaf: first entry in order
+        int count;      // 0 for interior nodes
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> order;         // object indices, leaves own contiguous ranges
+    std::vector<JklAabb> boxes;
+    bool dirty = false;
+
+    void split(int node, std::vector<glm::vec3>& centroids, int depth);
+    void collect(int node, std::vector<int>& out) const;
+};
+
+// ray / box slab test, t is the entry distance (0 when the origin is inside)
+bool jklRayAabb(const glm::vec3& origin, const glm::vec3& inverseDirection, const JklAabb& box, float maxDistance, float& t);
+
+#endif
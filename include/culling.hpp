@@ -0,0 +1,95 @@
+#ifndef _CULLING_HPP_
+#define _CULLING_HPP_
+
+#include <glm/glm.hpp>
+#include <cfloat>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#define JKL_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// Bounding volumes and view frustum tests. Meshes compute their bounds once at load, the draw
+// calls taking a JklFrustum test them in world space and skip everything off screen.
+
+struct JklAabb {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool valid(void) const { return min.x <= max.x; };
+    glm::vec3 center(void) const { return (min + max) * 0.5f; };
+    glm::vec3 extents(void) const { return (max - min) * 0.5f; };
+
+    void expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    };
+    void expand(const JklAabb& other) {
+        if (!other.valid())
+            return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    };
+
+    // box enclosing this one after an affine transform (Arvo)
+    JklAabb transformed(const glm::mat4& m) const;
+};
+
+struct JklSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = -1.0f;
+
+    bool valid(void) const { return radius >= 0.0f; };
+    // the radius grows with the largest axis scale of m
+    JklSphere transformed(const glm::mat4& m) const;
+};
+
+// sphere around the box centre that encloses every point, points are the ones the box was built from
+JklSphere jklBoundingSphere(const JklAabb& box, const glm::vec3* points, size_t count, size_t stride = sizeof(glm::vec3));
+
+// the six planes of a view-projection matrix, kept as structure of arrays so four planes are
+// tested per SSE instruction. Planes 6 and 7 repeat plane 0 to fill the second group of four.
+class JklFrustum {
+public:
+    JklFrustum(void) {};
+    explicit JklFrustum(const glm::mat4& viewProjection) { extract(viewProjection); };
+
+    void extract(const glm::mat4& viewProjection);
+
+    // false when the volume is completely outside one of the planes
+    bool testAabb(const JklAabb& box) const;
+    bool testSphere(const JklSphere& sphere) const;
+    // true when the box is completely inside every plane, lets hierarchies accept whole subtrees
+    bool containsAabb(const JklAabb& box) const;
+    // object space bounds placed with transform: the sphere rejects first, the box decides
+    bool testBounds(const JklAabb& box, const JklSphere& sphere, const glm::mat4& transform) const;
+
+    // plane i as (normal, distance), inside where dot(normal, p) + distance >= 0.
+    // 0 left, 1 right, 2 bottom, 3 top, 4 near, 5 far
+    glm::vec4 plane(int i) const { return glm::vec4(nx[i], ny[i], nz[i], nd[i]); };
+
+private:
+    alignas(16) float nx[8], ny[8], nz[8], nd[8];
+};
+
+// per frame counters, reset by jklrun before the scene draws
+struct JklCullStats {
+    int tested = 0;
+    int visible = 0;
+    int culled = 0;
+    int occluded = 0;   // passed the frustum but hidden behind occluders, also counted in culled
+
+    bool record(bool isVisible) {
+        tested++;
+        if (isVisible)
+            visible++;
+        else
+            culled++;
+        return isVisible;
+    };
+};
+
+extern JklCullStats jklCullStats;
+
+#endif
@@ -15,22 +15,95 @@
 #include <thread>
 #endif
 
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include "renderframe.hpp"
+#include "log.hpp"
+#include "profiler.hpp"
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void processInput(GLFWwindow *window);
 
-void jklstart(unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT);
+// false when there is no window, GL context or GL loader. Nothing is left running then, the caller
+// should exit
+bool jklstart(unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT);
 extern GLFWwindow* window;
+extern GLFWwindow* uploadWindow;
+// set before jklstart to upload streamed assets from a background thread with its own shared context
+extern bool jklUploadThread;
+// set before jklrun to draw on a render thread owning the GL context while the main thread runs
+// input, ticks and codeFrame for the next frame. jklFrameBuffers frames (2 or 3) are in flight
+extern bool jklRenderThread;
+extern int jklFrameBuffers;
+// set before jklstart to run without a display, for benchmarks on machines without a GPU. The
+// window is never shown (with GLFW 3.4 no display is opened at all) and the context is created
+// through OSMesa or EGL when GLFW offers them, so Mesa's llvmpipe can render it. Frames are drawn
+// into an offscreen framebuffer, each one advances exactly one tick, and jklrun returns once
+// jklHeadlessFrames frames have been drawn
+extern bool jklHeadless;
+extern int jklHeadlessFrames;
 
 extern int countywounty;
 extern int inputdir;
 extern int buttontec;
 extern float deltaTime;
 
+// Simulation runs in fixed ticks, decoupled from rendering. Each frame adds its real duration to
+// an accumulator and runs codeTick once per whole jklFixedDeltaTime in it, then codeLoop draws
+// once. Gameplay state changed in codeTick is the same at any frame rate; codeLoop only reads it,
+// blending the last two ticks by jklRenderAlpha so motion stays smooth between them.
+//
+// ticks per second, set before jklrun. Lower it to simulate less often than the screen refreshes
+extern float jklTickRate;
+// seconds per tick, 1 / jklTickRate
+extern float jklFixedDeltaTime;
+// how far the frame being drawn is past the last tick, in ticks [0, 1)
+extern float jklRenderAlpha;
+extern unsigned long long jklTickCount;
+// ticks run in one frame at most, time past that is dropped so a long stall can't snowball
+extern int jklMaxTicksPerFrame;
+
 struct JklScene {
-    virtual void codeInit(void) { std::cout << "BEHAVIOUR UNDEFINED ! : BEGIN " << std::endl;};
-    virtual void codeLoop(void) { std::cout << "BEHAVIOUR UNDEFINED ! : LOOP " << std::endl;};
+    virtual void codeInit(void) { JKL_WARN(ELOG_GAME, "BEHAVIOUR UNDEFINED ! : BEGIN");};
+    // fixed rate simulation, advance by jklFixedDeltaTime
+    virtual void codeTick(void) {};
+    // once per frame, draws the state left by the ticks
+    virtual void codeLoop(void) { JKL_WARN(ELOG_GAME, "BEHAVIOUR UNDEFINED ! : LOOP");};
+    // once per frame on the game thread, records what to draw for the render thread. The default
+    // draws with codeLoop and keeps the game thread waiting until it is done, scenes overriding
+    // this instead copy the state they draw into the frame and don't wait
+    virtual void codeFrame(JklFrame& frame) {
+        frame.serial = true;
+        frame.record([this](const JklFrame&) {
+            JKL_PROFILE_SCOPE("codeLoop");
+            codeLoop();
+        });
+    };
+};
+
+inline float jklInterpolate(float a, float b, float alpha) { return a + (b - a) * alpha; }
+inline glm::vec3 jklInterpolate(const glm::vec3& a, const glm::vec3& b, float alpha) { return glm::mix(a, b, alpha); }
+inline glm::quat jklInterpolate(const glm::quat& a, const glm::quat& b, float alpha) { return glm::slerp(a, b, alpha); }
+
+// a value updated in codeTick and drawn in codeLoop. tick() at the start of every codeTick keeps the
+// previous tick's value, render() blends the two by jklRenderAlpha
+template<typename T>
+struct JklTickState {
+    T previous;
+    T current;
+
+    JklTickState(void) : previous(), current() {};
+    JklTickState(const T& value) : previous(value), current(value) {};
+
+    void tick(void) { previous = current; };
+    // jumps without blending, for teleports and resets
+    void snap(const T& value) { previous = current = value; };
+    T render(void) const { return jklInterpolate(previous, current, jklRenderAlpha); };
 };
 
 void jklsetScene(JklScene* nscene);
@@ -0,0 +1,42 @@
+#ifndef _GPURESOURCES_HPP_
+#define _GPURESOURCES_HPP_
+
+#include <cstddef>
+
+// Bookkeeping for GPU memory. Every owner of GL objects (Mesh, StaticMesh, textures) reports the
+// bytes it uploads and frees here, so live usage per resource type is known at any time.
+
+enum EGPU_RESOURCE {
+    EGPU_MESH,          // Mesh vertex and index buffers
+    EGPU_STATICMESH,    // StaticMesh (.jkl level) vertex buffers
+    EGPU_TEXTURE,       // 2D textures and texture arrays, mips included
+    EGPU_RESOURCE_COUNT
+};
+
+// true between jklstart and the end of jklrun. Owners destroyed after the context is gone
+// (statics, scenes on main's stack) skip their glDelete* calls.
+extern bool jklGpuContextAlive;
+
+// false drops the CPU copies of Mesh/StaticMesh geometry once it is on the GPU. Meshes can then
+// still be drawn, but not re-uploaded (evicted streamed assets are reloaded from disk anyway)
+extern bool jklKeepCpuGeometry;
+
+void jklGpuTrack(EGPU_RESOURCE type, long long bytes);
+long long jklGpuBytes(EGPU_RESOURCE type);
+long long jklGpuTotalBytes(void);
+const char* jklGpuResourceName(EGPU_RESOURCE type);
+
+// textures are plain ids, their size is remembered here so deleting them can be accounted for
+void jklGpuRegisterTexture(unsigned int texture, size_t bytes);
+void jklDeleteTexture(unsigned int texture);
+
+// prints live bytes per resource type
+void jklGpuReport(void);
+
+// current and peak resident set size of the process in bytes, 0 where unsupported
+size_t jklProcessRss(void);
+size_t jklProcessPeakRss(void);
+// prints both, labelled
+void jklReportMemory(const char* label);
+
+#endif
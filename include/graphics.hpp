@@ -12,6 +12,7 @@
 #include <vector>
 #include <functional>
 #include <map>
+#include <memory>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
@@ -27,6 +28,16 @@
 #include<assimp/matrix4x4.h>
 
 #include "stb_image.h"
+#include "textures.hpp"
+#include "gpuresources.hpp"
+#include "culling.hpp"
+#include "portals.hpp"
+#include "levelfile.hpp"
+#include "pvs.hpp"
+#include "log.hpp"
+#include "profiler.hpp"
+#include "arena.hpp"
+#include "memtrack.hpp"
 
 extern int LastThingDrawn;
 
@@ -75,6 +86,7 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath)
     {
+        JKL_MEM_TAG(EMEM_SHADER);
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -101,7 +113,7 @@ public:
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            JKL_ERROR(ELOG_RENDER, "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: %s", e.what());
         }
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
@@ -134,63 +146,69 @@ public:
     { 
         glUseProgram(ID); 
     }
-    // utility uniform functions
+    // utility uniform functions, names are C strings so per frame calls with literals never build a std::string
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const char* name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(glGetUniformLocation(ID, name), (int)value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const char* name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(glGetUniformLocation(ID, name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const char* name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(glGetUniformLocation(ID, name), value); 
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const char* name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]); 
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const char* name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(glGetUniformLocation(ID, name), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const char* name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]); 
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const char* name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(glGetUniformLocation(ID, name), x, y, z); 
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const char* name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]); 
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    void setVec4(const char* name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(glGetUniformLocation(ID, name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const char* name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const char* name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const char* name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    // count matrices into a uniform array from element 0, one call for a whole bone palette
+    void setMat4Array(const char* name, const glm::mat4* mats, int count) const
+    {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), count, GL_FALSE, &mats[0][0][0]);
     }
 
 private:
@@ -206,7 +224,7 @@ private:
             if (!success)
             {
                 glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                JKL_ERROR(ELOG_RENDER, "ERROR::SHADER_COMPILATION_ERROR of type: %s\n%s", type.c_str(), infoLog);
             }
         }
         else
@@ -215,7 +233,7 @@ private:
             if (!success)
             {
                 glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                JKL_ERROR(ELOG_RENDER, "ERROR::PROGRAM_LINKING_ERROR of type: %s\n%s", type.c_str(), infoLog);
             }
         }
     }
@@ -336,192 +354,272 @@ public:
 extern Camera camera;
 extern float baseheight;
 
-typedef struct vert {
-    float x,y,z;
-} vert;
-
-typedef struct txc {
-    float x,y;
-} txc;
-
-
-typedef struct mat {
-    float r,g,b;
-    bool tex;
-} mat;
-
-typedef struct trindex {
-    	int matid;
-		int vt1, vt2, vt3, uv1, uv2, uv3, vn1, vn2, vn3;
-} trindex;
-
 class StaticMesh {
     public :
-        int pntnum, plycnt;
-        unsigned int VBO, VAO;
-        Shader *shader;
+        // interleaved position, colour, normal, uv, texture array layer
+        static const int STRIDE = 12;
+
+        int pntnum = 0, plycnt = 0;
+        unsigned int VBO = 0, VAO = 0;
+        size_t gpuBytes = 0;
+        Shader *shader = nullptr;
+        // object space bounds of the level geometry, filled by ReadFile
+        JklAabb bounds;
+        JklSphere sphere;
+        // cells and portals, from the level's .jkp or generated on a cellSize grid. Set cellSize
+        // before loading, 0 only uses an authored .jkp
+        float cellSize = 0.0f;
+        JklCellGraph cells;
+        // precomputed visibility from the level's .jkv (tools/jkpvs), replaces the portal walk
+        JklPvs pvs;
+        // interleaved triangle list, occlusion culling reads its positions too. Gone after
+        // DropGeometry, so occluders need jklKeepCpuGeometry
         std::vector<float> vertices;
-
-        void LoadModel(char* path, Shader* shader) {
-            std::ifstream infile(path, std::ios::binary);
-            int vcnt, uvcnt, ncnt, tricnt, mtlcnt;
-
-            std::vector<vert> pointtable;
-            std::vector<txc> uvtable;
-            std::vector<vert> normaltable;
-            std::vector<trindex> trilist;
-            std::vector<mat> matlist;
-
-            infile.read(reinterpret_cast<char*>(&vcnt),sizeof(int));
-            infile.read(reinterpret_cast<char*>(&uvcnt),sizeof(int));
-            infile.read(reinterpret_cast<char*>(&ncnt),sizeof(int));
-            infile.read(reinterpret_cast<char*>(&tricnt),sizeof(int));
-            infile.read(reinterpret_cast<char*>(&mtlcnt),sizeof(int));
-
-            for(int i = 0; i < vcnt; i++) { // loads point table
-                float xx,yy,zz;
-                infile.read(reinterpret_cast<char*>(&xx),sizeof(float));
-                infile.read(reinterpret_cast<char*>(&yy),sizeof(float));
-                infile.read(reinterpret_cast<char*>(&zz),sizeof(float));
-                pointtable.push_back((vert){xx,yy,zz});
+        std::vector<mat> matlist;
+        // texture array layer per material index, set before ReadFile. Missing entries use layer 0
+        std::vector<int> materialLayers;
+
+        // the mesh owns its GL objects, so it can be moved but not copied
+        StaticMesh(void) {};
+        StaticMesh(const StaticMesh&) = delete;
+        StaticMesh& operator=(const StaticMesh&) = delete;
+        StaticMesh(StaticMesh&& other) { *this = std::move(other); }
+        StaticMesh& operator=(StaticMesh&& other) {
+            if (this != &other) {
+                Release();
+                pntnum = other.pntnum;
+                plycnt = other.plycnt;
+                VBO = other.VBO;
+                VAO = other.VAO;
+                gpuBytes = other.gpuBytes;
+                shader = other.shader;
+                bounds = other.bounds;
+                sphere = other.sphere;
+                cellSize = other.cellSize;
+                cells = std::move(other.cells);
+                pvs = std::move(other.pvs);
+                vertices = std::move(other.vertices);
+                matlist = std::move(other.matlist);
+                materialLayers = std::move(other.materialLayers);
+                other.VBO = other.VAO = 0;
+                other.gpuBytes = 0;
             }
-
-            for(int i = 0; i < uvcnt; i++) { // loads point table
-                float xx,yy;
-                infile.read(reinterpret_cast<char*>(&xx),sizeof(float));
-                infile.read(reinterpret_cast<char*>(&yy),sizeof(float));
-                uvtable.push_back((txc){xx,yy});
-            }
-
-            for(int i = 0; i < ncnt; i++) { // loads point table
-                float xx,yy,zz;
-                infile.read(reinterpret_cast<char*>(&xx),sizeof(float));
-                infile.read(reinterpret_cast<char*>(&yy),sizeof(float));
-                infile.read(reinterpret_cast<char*>(&zz),sizeof(float));
-                normaltable.push_back((vert){xx,yy,zz});
+            return *this;
+        }
+        ~StaticMesh(void) { Release(); }
+
+        // deletes the VAO/VBO, Upload can be called again as long as the vertex array wasn't dropped
+        void Release(void) {
+            if (jklGpuContextAlive) {
+                if (VAO != 0)
+                    glDeleteVertexArrays(1, &VAO);
+                if (VBO != 0)
+                    glDeleteBuffers(1, &VBO);
             }
+            VAO = VBO = 0;
+            jklGpuTrack(EGPU_STATICMESH, -(long long)gpuBytes);
+            gpuBytes = 0;
+        }
 
+        // false when the level can't be read, jklReadLevel has logged why and nothing is uploaded
+        bool LoadModel(const char* path, Shader* shader) {
+            if (!ReadFile(path))
+                return false;
+            BuildCells(path);
+            Upload(shader);
+            return true;
+        }
 
-            for(int i = 0; i < tricnt; i++) {
-                uint8_t matid;
-		        int vt1, vt2, vt3, uv1, uv2, uv3, vn1, vn2, vn3;
+        // parses a .jkl file into the interleaved vertex array, touches no GL state so it can run on a loader thread
+        bool ReadFile(const char* path) {
+            JKL_MEM_TAG(EMEM_LEVEL);
+            JklLevelData level;
+            if (!jklReadLevel(path, level))
+                return false;
+
+            matlist.swap(level.materials);
+            for (size_t i = 0; i < matlist.size(); i++)
+                matlist[i].layer = i < materialLayers.size() ? materialLayers[i] : 0;
+
+            const size_t tricnt = level.triangles.size();
+            this->vertices.clear();
+            this->vertices.reserve(tricnt * 3 * STRIDE);
+            for (const trindex& tri : level.triangles) {
+                const mat& material = matlist[tri.matid];
+                const int corners[3][3] = {{tri.vt1, tri.vn1, tri.uv1}, {tri.vt2, tri.vn2, tri.uv2}, {tri.vt3, tri.vn3, tri.uv3}};
+                for (const int* corner : corners) {
+                    const vert& point = level.points[corner[0]];
+                    const vert& normal = level.normals[corner[1]];
+                    const txc& uv = level.uvs[corner[2]];
+                    const float vertex[STRIDE] = {point.x, point.y, point.z, material.r, material.g, material.b,
+                                                  normal.x, normal.y, normal.z, uv.x, uv.y, (float)material.layer};
+                    this->vertices.insert(this->vertices.end(), vertex, vertex + STRIDE);
+                }
+            }
 
-                infile.read(reinterpret_cast<char*>(&matid),sizeof(uint8_t));
+            this->plycnt = (int)tricnt;
 
-                infile.read(reinterpret_cast<char*>(&vt1),sizeof(int));
-                infile.read(reinterpret_cast<char*>(&uv1),sizeof(int));
-                infile.read(reinterpret_cast<char*>(&vn1),sizeof(int));                
-                
-                infile.read(reinterpret_cast<char*>(&vt2),sizeof(int));
-                infile.read(reinterpret_cast<char*>(&uv2),sizeof(int));
-                infile.read(reinterpret_cast<char*>(&vn2),sizeof(int));                
-                
-                infile.read(reinterpret_cast<char*>(&vt3),sizeof(int));
-                infile.read(reinterpret_cast<char*>(&uv3),sizeof(int));
-                infile.read(reinterpret_cast<char*>(&vn3),sizeof(int));
+            // positions are the first three floats of every interleaved vertex
+            const size_t stride = STRIDE * sizeof(float);
+            size_t count = this->vertices.size() / STRIDE;
+            this->bounds = JklAabb();
+            for (size_t i = 0; i < count; i++)
+                this->bounds.expand(*(const glm::vec3*)&this->vertices[i * STRIDE]);
+            this->sphere = jklBoundingSphere(this->bounds, (const glm::vec3*)this->vertices.data(), count, stride);
+            return true;
+        }
 
-                trilist.push_back((trindex){(int)matid,vt1,vt2,vt3,uv1,uv2,uv3,vn1,vn2,vn3});
+        // sets up cells for the level read by ReadFile and sorts its triangles so every cell is one
+        // contiguous draw range. A .jkv brings its own grid cells, otherwise they come from the .jkp
+        // or are generated. Runs before Upload, false when the level has no cells
+        bool BuildCells(const char* path) {
+            JKL_MEM_TAG(EMEM_LEVEL);
+            // the cell code wants packed positions, only kept while the cells are built
+            std::vector<glm::vec3> positions(this->vertices.size() / STRIDE);
+            for (size_t i = 0; i < positions.size(); i++)
+                positions[i] = *(const glm::vec3*)&this->vertices[i * STRIDE];
+            std::string sidecar = jklSidecarPath(path, ".jkp");
+            std::string visibility = jklSidecarPath(path, ".jkv");
+            if (pvs.load(visibility.c_str(), path)) {
+                // the PVS grid cells, jkpvs sorted the triangles the same way
+                cells = JklCellGraph();
+                cells.cells.resize(pvs.cellCount());
+                for (int i = 0; i < pvs.cellCount(); i++)
+                    cells.cells[i].box = pvs.cellBox(i);
             }
-
-            for(int i = 0; i < mtlcnt; i++) {
-                float rr,gg,bb;
-                uint8_t texuse;
-                bool istex = false;
-			    infile.read(reinterpret_cast<char*>(&texuse),sizeof(uint8_t));
-			    infile.read(reinterpret_cast<char*>(&rr),sizeof(float)); 
-			    infile.read(reinterpret_cast<char*>(&gg),sizeof(float)); 	
-			    infile.read(reinterpret_cast<char*>(&bb),sizeof(float)); 	
-
-                if(texuse != 0) istex = true;
-                matlist.push_back((mat){rr,gg,bb,istex});
+            else if (!cells.load(sidecar.c_str())) {
+                if (cellSize <= 0.0f)
+                    return false;
+                cells.generate(positions.data(), positions.size(), cellSize);
+                if (cells.empty())
+                    return false;
             }
 
+            std::vector<int> order = cells.assignTriangles(positions.data(), positions.size());
+            std::vector<float> sorted;
+            sorted.reserve(this->vertices.size());
+            const size_t triangleFloats = 3 * STRIDE;
+            for (int t : order)
+                sorted.insert(sorted.end(), this->vertices.begin() + t * triangleFloats, this->vertices.begin() + (t + 1) * triangleFloats);
+            this->vertices.swap(sorted);
+            return true;
+        }
 
-            for(int i = 0; i < tricnt; i++) {
-                this->vertices.push_back(pointtable[trilist[i].vt1].x);
-                this->vertices.push_back(pointtable[trilist[i].vt1].y);
-                this->vertices.push_back(pointtable[trilist[i].vt1].z);
-
-                this->vertices.push_back(matlist[trilist[i].matid].r);
-                this->vertices.push_back(matlist[trilist[i].matid].g);
-                this->vertices.push_back(matlist[trilist[i].matid].b);
-
-                this->vertices.push_back(normaltable[trilist[i].vn1].x);
-                this->vertices.push_back(normaltable[trilist[i].vn1].y);
-                this->vertices.push_back(normaltable[trilist[i].vn1].z);
-
-                this->vertices.push_back(uvtable[trilist[i].uv1].x);
-                this->vertices.push_back(uvtable[trilist[i].uv1].y);
-
-
-                this->vertices.push_back(pointtable[trilist[i].vt2].x);
-                this->vertices.push_back(pointtable[trilist[i].vt2].y);
-                this->vertices.push_back(pointtable[trilist[i].vt2].z);
-
-                this->vertices.push_back(matlist[trilist[i].matid].r);
-                this->vertices.push_back(matlist[trilist[i].matid].g);
-                this->vertices.push_back(matlist[trilist[i].matid].b);
-
-                this->vertices.push_back(normaltable[trilist[i].vn2].x);
-                this->vertices.push_back(normaltable[trilist[i].vn2].y);
-                this->vertices.push_back(normaltable[trilist[i].vn2].z);
-
-                this->vertices.push_back(uvtable[trilist[i].uv2].x);
-                this->vertices.push_back(uvtable[trilist[i].uv2].y);
-
-
-                this->vertices.push_back(pointtable[trilist[i].vt3].x);
-                this->vertices.push_back(pointtable[trilist[i].vt3].y);
-                this->vertices.push_back(pointtable[trilist[i].vt3].z);
-
-                this->vertices.push_back(matlist[trilist[i].matid].r);
-                this->vertices.push_back(matlist[trilist[i].matid].g);
-                this->vertices.push_back(matlist[trilist[i].matid].b);
-
-                this->vertices.push_back(normaltable[trilist[i].vn3].x);
-                this->vertices.push_back(normaltable[trilist[i].vn3].y);
-                this->vertices.push_back(normaltable[trilist[i].vn3].z);
+        // creates the VAO/VBO from the vertex array built by ReadFile, must run on the GL thread
+        void Upload(Shader* shader) {
+            UploadBuffers();
+            SetupVertexArray(shader);
+        }
 
-                this->vertices.push_back(uvtable[trilist[i].uv3].x);
-                this->vertices.push_back(uvtable[trilist[i].uv3].y);
-            }
+        // fills the VBO, buffers are shared between contexts so this may run on the upload context
+        void UploadBuffers() {
+            glGenBuffers(1, &this->VBO);
+            glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(float) * this->vertices.size(), &this->vertices[0], GL_STATIC_DRAW);
+            this->gpuBytes = sizeof(float) * this->vertices.size();
+            jklGpuTrack(EGPU_STATICMESH, (long long)this->gpuBytes);
+        }
 
+        // VAOs are not shared between contexts, this always runs on the render context
+        void SetupVertexArray(Shader* shader) {
             glGenVertexArrays(1, &this->VAO);
-            glGenBuffers(1, &this->VBO);
-        
             glBindVertexArray(this->VAO);
-        
             glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(float) * this->vertices.size(), &this->vertices[0], GL_STATIC_DRAW);
         
             // position attribute
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, STRIDE * sizeof(float), (void*)0);
             glEnableVertexAttribArray(0);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(3 * sizeof(float)));
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, STRIDE * sizeof(float), (void*)(3 * sizeof(float)));
             glEnableVertexAttribArray(1);
-            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(6 * sizeof(float)));
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, STRIDE * sizeof(float), (void*)(6 * sizeof(float)));
             glEnableVertexAttribArray(2);
-            glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(9 * sizeof(float)));
+            glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, STRIDE * sizeof(float), (void*)(9 * sizeof(float)));
             glEnableVertexAttribArray(3);
-
-            this->plycnt = tricnt;
+            glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, STRIDE * sizeof(float), (void*)(11 * sizeof(float)));
+            glEnableVertexAttribArray(4);
 
             this->shader = shader;
-
-            infile.close();
+            if (!jklKeepCpuGeometry)
+                DropGeometry();
         }
 
+        // frees the CPU vertex array, the mesh can still be drawn but not uploaded again
+        void DropGeometry() {
+            std::vector<float>().swap(this->vertices);
+        }
 
-        void Draw(glm::vec3 position, glm::vec3 scale, glm::vec3 rotation) {
 
-            glBindVertexArray(this->VAO);
+        static glm::mat4 Transform(glm::vec3 position, glm::vec3 scale, glm::vec3 rotation) {
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, position);
             model = glm::scale(model,scale);
             model = glm::rotate(model, (rotation.x * ( 3.14159265358979323846f / 180.0f )), glm::vec3(1.f,0.f,0.f));
             model = glm::rotate(model, (rotation.y * ( 3.14159265358979323846f / 180.0f )), glm::vec3(0.f,1.f,0.f));
             model = glm::rotate(model, (rotation.z * ( 3.14159265358979323846f / 180.0f )), glm::vec3(0.f,0.f,1.f));
+            return model;
+        }
 
+        void Draw(glm::vec3 position, glm::vec3 scale, glm::vec3 rotation) {
+            DrawTransformed(Transform(position, scale, rotation));
+        }
+
+        // skips the draw when the placed bounds are outside the frustum
+        void Draw(const JklFrustum& frustum, glm::vec3 position, glm::vec3 scale, glm::vec3 rotation) {
+            glm::mat4 model = Transform(position, scale, rotation);
+            if (jklCullStats.record(frustum.testBounds(this->bounds, this->sphere, model)))
+                DrawTransformed(model);
+        }
+
+        // draws only the cells visible from eye, from the PVS row of eye's cell or through the portals.
+        // Everything is drawn without cells
+        void DrawVisible(const glm::vec3& eye, const glm::mat4& viewProjection, const glm::mat4& model) {
+            JKL_PROFILE_SCOPE("drawVisible");
+            if (cells.empty()) {
+                DrawTransformed(model);
+                return;
+            }
+            // the walk happens in level space
+            glm::vec3 localEye = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.0f));
+            JklArenaScope scope;
+            JklFrameVector<int> visible;
+            visible.reserve(cells.cells.size());
+            int pvsCell = pvs.empty() ? -1 : pvs.cellAt(localEye);
+            if (pvsCell >= 0) {
+                // the row is the visibility query, only the frustum is left to test
+                JklFrustum frustum(viewProjection * model);
+                for (int index : pvs.visibleCells(pvsCell))
+                    if (frustum.testAabb(cells.cells[index].drawBounds))
+                        visible.push_back(index);
+            }
+            else
+                cells.visibleCells(localEye, viewProjection * model, visible);
+            jklCullStats.tested += (int)cells.cells.size();
+            jklCullStats.visible += (int)visible.size();
+            jklCullStats.culled += (int)(cells.cells.size() - visible.size());
+
+            glBindVertexArray(this->VAO);
+            this->shader->setMat4("model", model);
+            // cells are stored in order, neighbouring visible cells merge into one draw
+            int first = 0, count = 0;
+            for (int index : visible) {
+                const JklCell& cell = cells.cells[index];
+                if (cell.count == 0)
+                    continue;
+                if (count > 0 && first + count == cell.first) {
+                    count += cell.count;
+                    continue;
+                }
+                if (count > 0)
+                    glDrawArrays(GL_TRIANGLES, first, count);
+                first = cell.first;
+                count = cell.count;
+            }
+            if (count > 0)
+                glDrawArrays(GL_TRIANGLES, first, count);
+        }
+
+        void DrawTransformed(const glm::mat4& model) {
+            glBindVertexArray(this->VAO);
             this->shader->setMat4("model", model);
             glDrawArrays(GL_TRIANGLES, 0, this->plycnt*3);
         }
@@ -771,45 +869,116 @@ public:
     std::vector<Vertex>       vertices;
     std::vector<unsigned int> indices;
     Texture      textures;
-    unsigned int VAO;
-
-    // constructor
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, Texture textures)
+    GLenum       textureTarget = GL_TEXTURE_2D;
+    int          layer = -1;        // layer inside a GL_TEXTURE_2D_ARRAY, -1 for a plain texture
+    std::string  texturePath;
+    unsigned int VAO = 0;
+    unsigned int indexCount = 0;    // survives dropGeometry(), Draw only needs this
+    JklAabb      bounds;            // bind pose, object space
+    JklSphere    sphere;
+
+    // constructor, pass upload = false to keep the mesh CPU-only until setupMesh() is called on the GL thread.
+    // pass the geometry with std::move, the vectors are taken over rather than copied
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, Texture textures, bool upload = true)
     {
-        this->vertices = vertices;
-        this->indices = indices;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
         this->textures = textures;
+        this->indexCount = (unsigned int)this->indices.size();
+        computeBounds();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if (upload)
+            setupMesh();
+    }
+
+    // the mesh owns its buffers and VAO but not its texture, which belongs to the Model
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&& other) { *this = std::move(other); }
+    Mesh& operator=(Mesh&& other)
+    {
+        if (this != &other)
+        {
+            release();
+            vertices = std::move(other.vertices);
+            indices = std::move(other.indices);
+            textures = other.textures;
+            textureTarget = other.textureTarget;
+            layer = other.layer;
+            texturePath = std::move(other.texturePath);
+            VAO = other.VAO;
+            indexCount = other.indexCount;
+            bounds = other.bounds;
+            sphere = other.sphere;
+            VBO = other.VBO;
+            EBO = other.EBO;
+            gpuBytes = other.gpuBytes;
+            other.VAO = other.VBO = other.EBO = 0;
+            other.gpuBytes = 0;
+        }
+        return *this;
+    }
+    ~Mesh() { release(); }
+
+    // deletes the GL objects, setupMesh can be called again as long as the geometry wasn't dropped
+    void release()
+    {
+        if (jklGpuContextAlive)
+        {
+            if (VAO != 0)
+                glDeleteVertexArrays(1, &VAO);
+            if (VBO != 0)
+                glDeleteBuffers(1, &VBO);
+            if (EBO != 0)
+                glDeleteBuffers(1, &EBO);
+        }
+        VAO = VBO = EBO = 0;
+        jklGpuTrack(EGPU_MESH, -(long long)gpuBytes);
+        gpuBytes = 0;
+    }
+
+    void computeBounds()
+    {
+        bounds = JklAabb();
+        for (const Vertex& vertex : vertices)
+            bounds.expand(vertex.Position);
+        sphere = jklBoundingSphere(bounds, vertices.empty() ? nullptr : &vertices[0].Position, vertices.size(), sizeof(Vertex));
     }
 
     // render the mesh
     void Draw(Shader &shader) 
     {        
-        
+        if (LastTextureBound != textures) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(textureTarget, textures);
+            LastTextureBound = textures;
+        }
+        if (layer >= 0)
+            shader.setInt("layer", layer);
+
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
+        uploadBuffers();
+        setupVertexArray();
+    }
+
+    // creates and fills the VBO/EBO, buffers are shared between contexts so this may run on the upload context
+    void uploadBuffers()
+    {
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
@@ -820,6 +989,18 @@ private:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
+        gpuBytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+        jklGpuTrack(EGPU_MESH, (long long)gpuBytes);
+    }
+
+    // VAOs are container objects and are never shared between contexts, this always runs on the render context
+    void setupVertexArray()
+    {
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
         // set the vertex attribute pointers
         // vertex Positions
         glEnableVertexAttribArray(0);	
@@ -844,7 +1025,22 @@ private:
 		glEnableVertexAttribArray(6);
 		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
         glBindVertexArray(0);
+
+        if (!jklKeepCpuGeometry)
+            dropGeometry();
+    }
+
+    // frees the CPU vertices and indices, the GPU copies stay drawable
+    void dropGeometry()
+    {
+        std::vector<Vertex>().swap(vertices);
+        std::vector<unsigned int>().swap(indices);
     }
+
+private:
+    // render data 
+    unsigned int VBO = 0, EBO = 0;
+    size_t gpuBytes = 0;
 };
 
 
@@ -856,11 +1052,53 @@ public:
 
     };
 
+    // the model owns the textures in textures_loaded, meshes only reference them
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    Model(Model&& other) { *this = std::move(other); }
+    Model& operator=(Model&& other)
+    {
+        if (this != &other)
+        {
+            releaseTextures();
+            textureArrays = std::move(other.textureArrays);
+            textures_loaded = std::move(other.textures_loaded);
+            textures_loaded_paths = std::move(other.textures_loaded_paths);
+            meshes = std::move(other.meshes);
+            directory = std::move(other.directory);
+            gammaCorrection = other.gammaCorrection;
+            uploadOnLoad = other.uploadOnLoad;
+            m_BoneInfoMap = std::move(other.m_BoneInfoMap);
+            m_BoneCounter = other.m_BoneCounter;
+            bounds = other.bounds;
+            boneBounds = std::move(other.boneBounds);
+            other.textures_loaded.clear();
+            other.textures_loaded_paths.clear();
+            other.meshes.clear();
+        }
+        return *this;
+    }
+    ~Model() { releaseTextures(); }
+
+    void releaseTextures()
+    {
+        for (Texture texture : textures_loaded)
+            jklDeleteTexture(texture);
+        textures_loaded.clear();
+        textures_loaded_paths.clear();
+        textureArrays.reset();
+    }
+
     // model data 
     std::vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    std::vector<std::string> textures_loaded_paths;	// file each entry of textures_loaded came from
+    std::unique_ptr<JklTextureArraySet> textureArrays;	// replaces textures_loaded with jklModelTextureArrays
+    JklAabb bounds;	// union of the mesh bounds
+    std::vector<JklAabb> boneBounds;	// bind pose box of the vertices each bone influences, by bone id
     std::vector<Mesh>    meshes;
     std::string directory;
-    bool gammaCorrection;
+    bool gammaCorrection = false;
+    bool uploadOnLoad = true;	// false when loaded by a streaming worker, meshes are uploaded later on the GL thread
 	
 	
 	std::map<std::string, BoneInfo> m_BoneInfoMap;
@@ -878,29 +1116,103 @@ public:
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // draws the meshes whose bounds, placed with transform, are inside the frustum. Skinned models
+    // pass the bone matrices the shader uses, the posed bounds then decide for the whole model
+    void Draw(Shader &shader, const JklFrustum& frustum, const glm::mat4& transform, const std::vector<glm::mat4>* pose = nullptr)
+    {
+        if (pose && !boneBounds.empty())
+        {
+            if (jklCullStats.record(frustum.testAabb(poseBounds(*pose).transformed(transform))))
+                Draw(shader);
+            return;
+        }
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            if (jklCullStats.record(frustum.testBounds(meshes[i].bounds, meshes[i].sphere, transform)))
+                meshes[i].Draw(shader);
+    }
+
+    // object space box of the model in a pose, each bone's bind box moved by its final matrix
+    JklAabb poseBounds(const std::vector<glm::mat4>& pose) const
+    {
+        JklAabb box;
+        size_t count = std::min(pose.size(), boneBounds.size());
+        for (size_t i = 0; i < count; i++)
+            box.expand(boneBounds[i].transformed(pose[i]));
+        return box.valid() ? box : bounds;
+    }
     
+	// decodes every distinct mesh texture into set, once the set is built useTextureArrays switches
+	// the meshes over so the whole model draws with one texture bind
+	void collectTextures(JklTextureArraySet& set)
+	{
+		// every layer of an array needs the same channel count, so decode to RGBA
+		std::vector<std::string> paths;
+		std::vector<std::future<JklImage>> decodes;
+		for (auto& mesh : meshes)
+		{
+			if (set.contains(mesh.texturePath) || std::find(paths.begin(), paths.end(), mesh.texturePath) != paths.end())
+				continue;
+			paths.push_back(mesh.texturePath);
+			decodes.push_back(jklDecodePool().decode(mesh.texturePath, 4));
+		}
+		for (size_t i = 0; i < paths.size(); i++)
+			set.add(paths[i], decodes[i].get());
+	}
+
+	// collects, uploads and switches to the model's own texture arrays, on the GL thread
+	void buildTextureArrays()
+	{
+		textureArrays.reset(new JklTextureArraySet());
+		collectTextures(*textureArrays);
+		textureArrays->build();
+		useTextureArrays(*textureArrays);
+	}
+
+	void useTextureArrays(const JklTextureArraySet& set)
+	{
+		for (auto& mesh : meshes)
+		{
+			unsigned int array;
+			int layer;
+			if (set.find(mesh.texturePath, array, layer))
+			{
+				mesh.textures = array;
+				mesh.textureTarget = GL_TEXTURE_2D_ARRAY;
+				mesh.layer = layer;
+			}
+		}
+	}
+
 	auto& GetBoneInfoMap() { return m_BoneInfoMap; }
 	int& GetBoneCount() { return m_BoneCounter; }
 	
 
 
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(std::string const &path)
+    // with upload = false no GL calls are made, each mesh keeps its texturePath for the caller to resolve.
+    void loadModel(std::string const &path, bool upload = true)
     {
+        JKL_MEM_TAG(EMEM_MESH);
+        uploadOnLoad = upload;
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
         // check for errors
        // if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
        // {
-            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            if (importer.GetErrorString()[0] != '\0')
+                JKL_ERROR(ELOG_ASSET, "ERROR::ASSIMP:: %s", importer.GetErrorString());
        //     return;
      //   }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
+        meshes.reserve(meshes.size() + scene->mNumMeshes);
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+        if (upload && jklModelTextureArrays)
+            buildTextureArrays();
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -936,7 +1248,9 @@ public:
 	{
 		std::vector<Vertex> vertices;
 		std::vector<unsigned int> indices;
-		std::vector<Texture> textures;
+		vertices.reserve(mesh->mNumVertices);
+		// aiProcess_Triangulate leaves only triangles
+		indices.reserve((size_t)mesh->mNumFaces * 3);
 
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
@@ -959,18 +1273,33 @@ public:
 		}
 		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 		{
-			aiFace face = mesh->mFaces[i];
+			const aiFace& face = mesh->mFaces[i];
 			for (unsigned int j = 0; j < face.mNumIndices; j++)
 				indices.push_back(face.mIndices[j]);
 		}
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-		Texture texture = TextureFromFile(std::string("resources/grid.png"), true);
+		std::string texturePath("resources/grid.png");
+		// texture arrays are built once every mesh is known, see loadModel
+		Texture texture = uploadOnLoad && !jklModelTextureArrays ? LoadCachedTexture(texturePath) : 0;
 
 
 		ExtractBoneWeightForVertices(vertices,mesh,scene);
+		ExpandBoneBounds(vertices);
 
-		return Mesh(vertices, indices, texture);
+		Mesh result(std::move(vertices), std::move(indices), texture, uploadOnLoad);
+		result.texturePath = texturePath;
+		bounds.expand(result.bounds);
+		return result;
+	}
+
+	void ExpandBoneBounds(const std::vector<Vertex>& vertices)
+	{
+		boneBounds.resize(m_BoneCounter);
+		for (const Vertex& vertex : vertices)
+			for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+				if (vertex.m_BoneIDs[i] >= 0 && vertex.m_Weights[i] > 0.0f)
+					boneBounds[vertex.m_BoneIDs[i]].expand(vertex.Position);
 	}
 
 	void SetVertexBoneData(Vertex& vertex, int boneID, float weight)
@@ -1024,43 +1353,22 @@ public:
 	}
 
 
-	unsigned int TextureFromFile(std::string path, bool gamma = false)
+	// every mesh of a model usually shares its textures, load each file once
+	Texture LoadCachedTexture(const std::string& path)
 	{
-		std::string filename = std::string(path);
-
-		unsigned int textureID;
-		glGenTextures(1, &textureID);
-
-		int width, height, nrComponents;
-		unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
-		if (data)
-		{
-			GLenum format;
-			if (nrComponents == 1)
-				format = GL_RED;
-			else if (nrComponents == 3)
-				format = GL_RGB;
-			else if (nrComponents == 4)
-				format = GL_RGBA;
-
-			glBindTexture(GL_TEXTURE_2D, textureID);
-			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Texture failed to load at path: " << path << std::endl;
-			stbi_image_free(data);
-		}
+		for (size_t i = 0; i < textures_loaded_paths.size(); i++)
+			if (textures_loaded_paths[i] == path)
+				return textures_loaded[i];
+		Texture texture = TextureFromFile(path, true);
+		textures_loaded.push_back(texture);
+		textures_loaded_paths.push_back(path);
+		return texture;
+	}
 
-		return textureID;
+	unsigned int TextureFromFile(std::string path, bool gamma = false)
+	{
+		// decoded, mipped on the CPU and streamed through a PBO, see textures.hpp
+		return jklLoadTexture(path.c_str(), GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
 	}
     
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -1084,6 +1392,7 @@ public:
 
 	Animation(const std::string& animationPath, Model* model)
 	{
+		JKL_MEM_TAG(EMEM_ANIMATION);
 		Assimp::Importer importer;
 		const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
 		assert(scene && scene->mRootNode);
@@ -1179,6 +1488,7 @@ public:
 
 	Animator(Animation* animation)
 	{
+		JKL_MEM_TAG(EMEM_ANIMATION);
 		m_CurrentTime = 0.0;
 		m_CurrentAnimation = animation;
 
@@ -1190,6 +1500,8 @@ public:
 
 	void UpdateAnimation(float dt)
 	{
+		JKL_PROFILE_SCOPE("animation");
+		JKL_MEM_TAG(EMEM_ANIMATION);
 		m_DeltaTime = dt;
 		if (m_CurrentAnimation)
 		{
@@ -1205,9 +1517,9 @@ public:
 		m_CurrentTime = 0.0f;
 	}
 
-	void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
+	void CalculateBoneTransform(const AssimpNodeData* node, const glm::mat4& parentTransform)
 	{
-		std::string nodeName = node->name;
+		const std::string& nodeName = node->name;
 		glm::mat4 nodeTransform = node->transformation;
 
 		Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
@@ -1220,19 +1532,16 @@ public:
 
 		glm::mat4 globalTransformation = parentTransform * nodeTransform;
 
-		auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-		if (boneInfoMap.find(nodeName) != boneInfoMap.end())
-		{
-			int index = boneInfoMap[nodeName].id;
-			glm::mat4 offset = boneInfoMap[nodeName].offset;
-			m_FinalBoneMatrices[index] = globalTransformation * offset;
-		}
+		const auto& boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
+		auto boneInfo = boneInfoMap.find(nodeName);
+		if (boneInfo != boneInfoMap.end())
+			m_FinalBoneMatrices[boneInfo->second.id] = globalTransformation * boneInfo->second.offset;
 
 		for (int i = 0; i < node->childrenCount; i++)
 			CalculateBoneTransform(&node->children[i], globalTransformation);
 	}
 
-	std::vector<glm::mat4> GetFinalBoneMatrices()
+	const std::vector<glm::mat4>& GetFinalBoneMatrices() const
 	{
 		return m_FinalBoneMatrices;
 	}
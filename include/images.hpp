@@ -0,0 +1,158 @@
+#ifndef _IMAGES_HPP_
+#define _IMAGES_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include "mingw.thread.h"
+#include "mingw.mutex.h"
+#include "mingw.condition_variable.h"
+#include "mingw.future.h"
+#endif
+
+#ifdef __linux__
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#endif
+
+// CPU side image handling, nothing in here touches GL so it is shared by the engine's
+// loader threads and the offline tools.
+
+// Decoded image data living on the CPU. Decoding touches no GL state, so it can be done
+// on any thread and handed over to the GL thread for jklUploadImage.
+// Level 0 is data, the optional mip chain built by jklBuildMipChain lives in mipData.
+struct JklImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    unsigned char* data = nullptr;
+    std::vector<unsigned char> mipData;
+    std::vector<size_t> mipOffsets;     // start of levels 1..n inside mipData
+
+    JklImage(void) {};
+    ~JklImage(void) { release(); };
+
+    JklImage(const JklImage&) = delete;
+    JklImage& operator=(const JklImage&) = delete;
+    JklImage(JklImage&& other) { *this = static_cast<JklImage&&>(other); };
+    JklImage& operator=(JklImage&& other);
+
+    size_t bytes(void) const { return (size_t)width * height * channels + mipData.size(); };
+    int levels(void) const { return 1 + (int)mipOffsets.size(); };
+    int levelWidth(int level) const { int w = width >> level; return w > 0 ? w : 1; };
+    int levelHeight(int level) const { int h = height >> level; return h > 0 ? h : 1; };
+    const unsigned char* levelData(int level) const { return level == 0 ? data : &mipData[mipOffsets[level - 1]]; };
+    size_t levelBytes(int level) const { return (size_t)levelWidth(level) * levelHeight(level) * channels; };
+    void release(void);
+};
+
+// Staging memory for decoded pixels. stb_image allocates through these (see images.cpp), so
+// decode buffers come from power of two free lists and are recycled between images instead of
+// hitting malloc for every texture. Blocks over the largest class fall back to malloc.
+void* jklStagingAlloc(size_t size);
+void* jklStagingRealloc(void* block, size_t size);
+void jklStagingFree(void* block);
+// bytes currently parked in the free lists, for stats
+size_t jklStagingPooledBytes(void);
+
+// loads an image from disk, forceChannels = 0 keeps the file's own channel count,
+// forceChannels < 0 decodes to jklUploadChannels of the file's count
+bool jklDecodeImage(const char* path, JklImage& image, int forceChannels = 0);
+
+// channel count to decode to for a given use. Single and dual channel images stay as they are,
+// RGB is widened to RGBA because drivers store it as RGBA anyway and convert on upload.
+// Texture arrays must force one count so every layer of a group matches.
+int jklUploadChannels(int fileChannels);
+
+// builds levels 1..n on the CPU with a 2x2 box filter, safe to run on loader threads
+void jklBuildMipChain(JklImage& image);
+
+
+// Decodes images on the job workers, or on a fixed set of threads of its own. Each decode returns
+// a future, so callers queue every image they need up front and collect them afterwards, which
+// spreads stb_image's work over all cores instead of decoding one texture after another on the
+// calling thread. Don't wait on a decode from inside a job.
+class JklDecodePool {
+public:
+    // threads = 0 queues decodes with jkljobRun, so loading shares the cores with the job system
+    // instead of adding a thread per core. Without jkljobStart they decode on the calling thread
+    explicit JklDecodePool(int threads = 0);
+    ~JklDecodePool(void);
+
+    JklDecodePool(const JklDecodePool&) = delete;
+    JklDecodePool& operator=(const JklDecodePool&) = delete;
+
+    // forceChannels as for jklDecodeImage. A failed decode yields an image with null data.
+    std::future<JklImage> decode(const std::string& path, int forceChannels = -1, bool mips = false);
+
+    int threadCount(void) const { return (int)workers.size(); };
+
+private:
+    void workerMain(void);
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void(void)>> jobs;
+    std::mutex mutex;
+    std::condition_variable signal;
+    bool stopping = false;
+};
+
+// shared pool used by the engine's loaders, created on first use, runs on the job workers
+JklDecodePool& jklDecodePool(void);
+
+
+// .jkt cooked texture container, written by tools/jkcook and loaded without any decoding at runtime.
+//   char[4]  "JKT1"
+//   uint32   format (EJKT_FORMAT), width, height, levels
+//   uint32   byte size of each level
+//   level data, largest first
+enum EJKT_FORMAT {
+    EJKT_R8,
+    EJKT_RG8,
+    EJKT_RGB8,
+    EJKT_RGBA8,
+    EJKT_BC1,       // DXT1, opaque RGB, 8 bytes per 4x4 block
+    EJKT_BC3        // DXT5, RGBA with interpolated alpha, 16 bytes per 4x4 block
+};
+
+struct JklCookedTexture {
+    uint32_t format = EJKT_RGBA8;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<unsigned char> data;
+    std::vector<size_t> offsets;
+    std::vector<size_t> sizes;
+
+    int levels(void) const { return (int)offsets.size(); };
+    int levelWidth(int level) const { int w = (int)width >> level; return w > 0 ? w : 1; };
+    int levelHeight(int level) const { int h = (int)height >> level; return h > 0 ? h : 1; };
+    const unsigned char* levelData(int level) const { return &data[offsets[level]]; };
+    bool compressed(void) const { return format == EJKT_BC1 || format == EJKT_BC3; };
+};
+
+// false, with the texture left empty, when the file is unreadable, truncated or its header and
+// level sizes don't describe a known format and size
+bool jklReadCookedTexture(const char* path, JklCookedTexture& texture);
+bool jklWriteCookedTexture(const char* path, const JklCookedTexture& texture);
+// the format is known and every level holds exactly the bytes its size and format need
+bool jklValidCookedTexture(const JklCookedTexture& texture);
+// bytes of one level of the given size, 0 for unknown formats
+size_t jklCookedLevelBytes(uint32_t format, int width, int height);
+// the image a .jkt was cooked from, next to it with the same name, empty when there is none
+std::string jklCookedTextureSource(const char* path);
+
+// builds a cooked texture from an image with its mip chain, compressing to BC1/BC3 when asked
+void jklCookImage(const JklImage& image, EJKT_FORMAT format, JklCookedTexture& out);
+
+// block codecs, width/height in pixels, rgba is tightly packed RGBA8
+size_t jklBlockCompressedSize(EJKT_FORMAT format, int width, int height);
+void jklCompressBlocks(EJKT_FORMAT format, const unsigned char* rgba, int width, int height, unsigned char* out);
+void jklDecompressBlocks(EJKT_FORMAT format, const unsigned char* blocks, int width, int height, unsigned char* rgba);
+
+#endif
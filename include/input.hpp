@@ -0,0 +1,81 @@
+#ifndef _INPUT_HPP_
+#define _INPUT_HPP_
+
+#include <cstdint>
+
+// Gameplay input as one snapshot per tick. The GLFW key, mouse button, cursor and scroll callbacks
+// only push events into a lock-free queue. At the start of every tick jklinputConsume drains it,
+// tracks which keys are down and maps them through the bindings to action buttons, so nothing is
+// polled and the cost depends on the events that happened, not the number of bound keys. A key
+// pressed and released between two ticks still counts as held for one tick.
+//
+// The tick then takes its snapshot through jklinputTick, which hands back the live state or,
+// while a replay runs, the recorded one. inputdir and buttontec are derived from that snapshot
+// only, so a replayed run feeds codeTick exactly the input of the recorded one. Together with
+// the fixed timestep (and jklHeadless for identical frames) that makes gameplay runs repeatable.
+//
+// Recordings (.jki) are "JKI2", float tick rate, uint32 count, then count snapshots of uint32
+// buttons and float lookX, lookY, scroll, one per tick from the tick the recording started on.
+
+enum EINPUT_BUTTON {
+    EINPUT_UP = 1 << 0,
+    EINPUT_RIGHT = 1 << 1,
+    EINPUT_DOWN = 1 << 2,
+    EINPUT_LEFT = 1 << 3,
+    EINPUT_ACTION = 1 << 4
+};
+
+struct JklInputSnapshot {
+    uint32_t buttons = 0;
+    // cursor movement in pixels and scroll wheel steps since the last tick
+    float lookX = 0.0f;
+    float lookY = 0.0f;
+    float scroll = 0.0f;
+
+    bool held(EINPUT_BUTTON button) const { return (buttons & button) != 0; };
+};
+
+enum EINPUT_EVENT {
+    EINPUT_KEY,
+    EINPUT_MOUSE_BUTTON,
+    EINPUT_CURSOR,
+    EINPUT_SCROLL
+};
+
+// key and mouse button events carry the GLFW code and action, cursor and scroll ones x and y
+struct JklInputEvent {
+    int type;
+    int code;
+    int action;
+    double x;
+    double y;
+};
+
+// the devices' state after the last jklinputConsume
+extern JklInputSnapshot jklLiveInput;
+// close the window once a replay has run out of ticks, for scripted captures
+extern bool jklReplayExit;
+
+// from the window callbacks, false when the queue is full and the event was dropped
+bool jklinputPushEvent(const JklInputEvent& event);
+// applies every queued event and returns jklLiveInput, once per tick
+JklInputSnapshot jklinputConsume(void);
+
+// maps a GLFW key (or mouse button with mouse = true) to an action, replacing its old binding.
+// W, D, S, A and J are bound to up, right, down, left and action by default
+void jklinputBind(int code, EINPUT_BUTTON button, bool mouse = false);
+void jklinputUnbind(int code, bool mouse = false);
+
+// the snapshot the current tick runs on, recorded when recording
+JklInputSnapshot jklinputTick(const JklInputSnapshot& live);
+
+// records every tick from the next one on, written out by jklinputStop
+bool jklinputRecord(const char* path);
+// replays a recording from the next tick on, false if it can't be read
+bool jklinputReplay(const char* path);
+bool jklinputRecording(void);
+bool jklinputReplaying(void);
+// ends replay and writes out the recording if one is running, false if writing failed
+bool jklinputStop(void);
+
+#endif
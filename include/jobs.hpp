@@ -0,0 +1,76 @@
+#ifndef _JOBS_HPP_
+#define _JOBS_HPP_
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#ifdef _WIN32
+#include "mingw.mutex.h"
+#endif
+
+#ifdef __linux__
+#include <mutex>
+#endif
+
+// Work stealing job system. Every worker thread owns a Chase-Lev deque: it runs its own jobs newest
+// first and, when out of work, steals the oldest job of a random other worker. The thread calling
+// jkljobStart becomes worker 0 and runs jobs whenever it waits on a counter. Any other thread (the
+// render thread, streaming loaders) can queue jobs too, they go through a shared queue.
+//
+// Jobs report to an optional counter. A counter is pending while any job on it is queued or
+// running; jkljobWait helps run jobs until it drops to zero, and jobs queued with jkljobRunAfter
+// only start once a counter is done, which is how dependencies are expressed.
+//
+// Jobs are recycled through a fixed pool, so queueing one doesn't touch the heap.
+//
+// Without jkljobStart every call runs its job straight away on the calling thread, so code using
+// jobs also works in tools that never start the system.
+
+struct JklJob;
+
+class JklJobCounter {
+public:
+    JklJobCounter(void) : pending(0) {};
+    JklJobCounter(const JklJobCounter&) = delete;
+    JklJobCounter& operator=(const JklJobCounter&) = delete;
+
+    bool done(void) const { return pending.load(std::memory_order_acquire) == 0; };
+
+private:
+    friend struct JklJobAccess;
+
+    std::atomic<int> pending;
+    std::mutex mutex;
+    std::vector<JklJob*> waiting;  // queued once pending drops to zero
+};
+
+struct JklWorkerStats {
+    unsigned long long jobs = 0;
+    unsigned long long steals = 0;
+    double busySeconds = 0.0;
+    double utilization = 0.0;   // busySeconds over the time since the last reset
+};
+
+// workers <= 0 starts one thread per core besides the calling one
+void jkljobStart(int workers = 0);
+// finishes the queued jobs and joins the workers, call from the thread that started them
+void jkljobStop(void);
+// threads running jobs, including the one that called jkljobStart. 1 when not started
+int jkljobWorkerCount(void);
+
+void jkljobRun(std::function<void(void)> job, JklJobCounter* counter = nullptr);
+// queues job once dependency is done
+void jkljobRunAfter(JklJobCounter& dependency, std::function<void(void)> job, JklJobCounter* counter = nullptr);
+// runs jobs until counter is done
+void jkljobWait(JklJobCounter& counter);
+
+// calls body on [first, last) ranges of at most grain indices covering [begin, end), spread over
+// the workers, and returns once all of them ran. The caller runs ranges too
+void jkljobParallelFor(int begin, int end, int grain, const std::function<void(int first, int last)>& body);
+
+// per worker, index 0 is the thread that called jkljobStart
+std::vector<JklWorkerStats> jkljobStats(void);
+void jkljobResetStats(void);
+void jkljobReport(void);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _LEVELCHUNKS_HPP_
+#define _LEVELCHUNKS_HPP_
+
+#include "streaming.hpp"
+#include "levelfile.hpp"
+
+#include <vector>
+
+// A level cooked into chunks (jkcook level) streamed around the camera. Chunks closer to the eye
+// than prefetchRadius are queued on the asset streamer, chunks farther than unloadRadius are
+// evicted, and between the two nothing changes so a camera moving along a chunk edge doesn't
+// make it load and unload every frame. Only the chunks around the camera take memory however
+// large the level is, and all loading happens on the streamer's threads.
+//
+// Distances are measured from the eye to the chunk's bounds, in level space.
+
+struct JklLevelChunk {
+    JklLevelChunkInfo info;
+    JklStaticMeshAsset* asset = nullptr;    // created the first time the chunk comes in range
+    bool wanted = false;                    // inside the radii as of the last update
+};
+
+class JklChunkedLevel {
+public:
+    float prefetchRadius = 100.0f;
+    // 0 uses prefetchRadius * 1.25
+    float unloadRadius = 0.0f;
+    // texture array layer per material, the same for every chunk since they share materials
+    std::vector<int> materialLayers;
+    std::vector<JklLevelChunk> chunks;
+    // chunks queued for loading (first time or after an eviction) and released by update so far
+    int loads = 0;
+    int releases = 0;
+
+    // reads a .jkc chunk list, no chunk is loaded until the first update
+    bool load(const char* path, Shader* shader);
+    // queues and evicts chunks around eye (world space), render thread, once per frame
+    void update(const glm::vec3& eye, const glm::mat4& model = glm::mat4(1.0f));
+    // draws the resident chunks in the frustum, through their cells when they have any
+    void draw(const glm::vec3& eye, const glm::mat4& viewProjection, const glm::mat4& model = glm::mat4(1.0f));
+
+    int residentChunks(void) const;
+    // queued or loading
+    int pendingChunks(void) const;
+
+private:
+    Shader* shader = nullptr;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _LEVELFILE_HPP_
+#define _LEVELFILE_HPP_
+
+#include "culling.hpp"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// .jkl level files, kept free of GL so the offline tools can read and write them.
+//
+//   int point count, uv count, normal count, triangle count, material count
+//   float x y z per point, float u v per uv, float x y z per normal
+//   per triangle: uint8 material, then int point, uv, normal for each of the three corners
+//   per material: uint8 textured, float r g b
+
+typedef struct vert {
+    float x,y,z;
+} vert;
+
+typedef struct txc {
+    float x,y;
+} txc;
+
+
+typedef struct mat {
+    float r,g,b;
+    bool tex;
+    int layer;  // texture array layer, see StaticMesh::materialLayers
+} mat;
+
+typedef struct trindex {
+    	int matid;
+		int vt1, vt2, vt3, uv1, uv2, uv3, vn1, vn2, vn3;
+} trindex;
+
+struct JklLevelData {
+    std::vector<vert> points;
+    std::vector<txc> uvs;
+    std::vector<vert> normals;
+    std::vector<trindex> triangles;
+    std::vector<mat> materials;     // layer is left 0, it isn't stored in the file
+};
+
+// false (with a message) for missing, truncated or inconsistent files
+bool jklReadLevel(const char* path, JklLevelData& level);
+bool jklWriteLevel(const char* path, const JklLevelData& level);
+
+// size and hash of a file's bytes, ties a .jkv to the exact .jkl it was built from
+bool jklLevelFingerprint(const char* path, uint64_t& size, uint64_t& hash);
+// corner positions of every triangle, three per triangle
+void jklLevelPositions(const JklLevelData& level, std::vector<glm::vec3>& out);
+// copies the listed triangles with only the points, uvs and normals they use. Materials are kept
+// whole so material ids, and the texture layers set up for them, stay the same
+void jklExtractLevel(const JklLevelData& level, const std::vector<int>& triangles, JklLevelData& out);
+
+// A level cooked into chunks by `jkcook level` is a set of smaller .jkl files listed in a .jkc
+// text file next to the source level. Chunk paths are relative to the .jkc.
+//
+//   # comment
+//   chunk <file> <min x y z> <max x y z>
+struct JklLevelChunkInfo {
+    std::string path;
+    JklAabb bounds;     // of the chunk's triangles
+};
+
+// paths come back resolved against the list's directory
+bool jklReadChunkList(const char* path, std::vector<JklLevelChunkInfo>& chunks);
+bool jklWriteChunkList(const char* path, const std::vector<JklLevelChunkInfo>& chunks);
+
+#endif
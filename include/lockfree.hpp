@@ -0,0 +1,225 @@
+#ifndef _LOCKFREE_HPP_
+#define _LOCKFREE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+
+// Bounded multi-producer / multi-consumer queue (Dmitry Vyukov's array queue).
+// Every cell carries a sequence number, so producers and consumers only contend on one CAS each
+// and never take a lock. Capacity must be a power of two. push/pop return false when full/empty.
+template<typename T>
+class JklMpmcQueue
+{
+public:
+    explicit JklMpmcQueue(size_t capacity) : cells(new Cell[capacity]), mask(capacity - 1)
+    {
+        assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        for (size_t i = 0; i < capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    ~JklMpmcQueue()
+    {
+        delete[] cells;
+    }
+
+    JklMpmcQueue(const JklMpmcQueue&) = delete;
+    JklMpmcQueue& operator=(const JklMpmcQueue&) = delete;
+
+    bool push(const T& value)
+    {
+        Cell* cell;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // full
+            else
+                pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+        cell->data = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // count values in consecutive cells claimed with one CAS, so no other producer's value lands
+    // between them and a single consumer pops them back to back. False, with nothing pushed, when
+    // they don't all fit
+    bool pushAll(const T* values, size_t count)
+    {
+        assert(count >= 1 && count <= mask + 1);
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            size_t free = 0;
+            intptr_t diff = 0;
+            for (; free < count; free++)
+            {
+                size_t seq = cells[(pos + free) & mask].sequence.load(std::memory_order_acquire);
+                diff = (intptr_t)seq - (intptr_t)(pos + free);
+                if (diff != 0)
+                    break;
+            }
+            if (free == count)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // full
+            else
+                pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            Cell* cell = &cells[(pos + i) & mask];
+            cell->data = values[i];
+            cell->sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    bool pop(T& out)
+    {
+        Cell* cell;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // empty
+            else
+                pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+        out = cell->data;
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // approximate, only meant for stats and idle checks
+    size_t size() const
+    {
+        size_t e = enqueuePos.load(std::memory_order_relaxed);
+        size_t d = dequeuePos.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    Cell* const cells;
+    const size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+};
+
+// Chase-Lev work stealing deque (with the memory orders from Le, Pop, Cohen and Nardelli, "Correct
+// and Efficient Work-Stealing for Weak Memory Models"). One owner thread pushes and pops at the
+// bottom, any thread steals from the top, so the owner works newest first and thieves take the
+// oldest, usually biggest, work. T must be trivially copyable. Fixed capacity, a power of two.
+template<typename T>
+class JklWorkStealingDeque
+{
+public:
+    explicit JklWorkStealingDeque(size_t capacity) : cells(new std::atomic<T>[capacity]), mask(capacity - 1)
+    {
+        assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        top.store(0, std::memory_order_relaxed);
+        bottom.store(0, std::memory_order_relaxed);
+    }
+
+    ~JklWorkStealingDeque()
+    {
+        delete[] cells;
+    }
+
+    JklWorkStealingDeque(const JklWorkStealingDeque&) = delete;
+    JklWorkStealingDeque& operator=(const JklWorkStealingDeque&) = delete;
+
+    // owner only, false when full
+    bool push(T value)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > (int64_t)mask)
+            return false;
+        cells[b & mask].store(value, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // owner only, newest first
+    bool pop(T& out)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false; // empty
+        }
+        out = cells[b & mask].load(std::memory_order_relaxed);
+        if (t != b)
+            return true;
+        // last element, a thief may be taking it at the same time
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    // any thread, oldest first. false when empty or another thread won the race
+    bool steal(T& out)
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+        T value = cells[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return false;
+        out = value;
+        return true;
+    }
+
+    // approximate, only meant for stats and idle checks
+    size_t size() const
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? (size_t)(b - t) : 0;
+    }
+
+private:
+    std::atomic<T>* const cells;
+    const size_t mask;
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+};
+
+#endif
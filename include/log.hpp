@@ -0,0 +1,90 @@
+#ifndef _LOG_HPP_
+#define _LOG_HPP_
+
+#include <cstdint>
+#include <functional>
+
+// Asynchronous logging. JKL_INFO(category, format, ...) formats printf style straight into a slot
+// of a lock-free ring buffer and returns; a logger thread drains the ring and hands every record to
+// the sinks (the console by default, a file with jkllogOpenFile). Nothing on the calling thread
+// waits for I/O. When the ring is full the record is dropped and counted rather than blocking.
+//
+// Every category has its own runtime level in jklLogLevels. Levels below JKL_LOG_MIN_LEVEL are
+// removed at compile time, arguments included, so per frame trace logging costs nothing in a
+// build made with -DJKL_LOG_MIN_LEVEL=2.
+//
+// Before jkllogStart (and in tools that never start it) records go to the sinks synchronously.
+
+enum ELOG_LEVEL {
+    ELOG_TRACE,
+    ELOG_DEBUG,
+    ELOG_INFO,
+    ELOG_WARN,
+    ELOG_ERROR,
+    ELOG_OFF
+};
+
+enum ELOG_CATEGORY {
+    ELOG_ENGINE,
+    ELOG_INPUT,
+    ELOG_RENDER,
+    ELOG_ASSET,
+    ELOG_MEMORY,
+    ELOG_JOBS,
+    ELOG_GAME,
+    ELOG_PROFILE,
+    ELOG_CATEGORY_COUNT
+};
+
+#ifndef JKL_LOG_MIN_LEVEL
+#define JKL_LOG_MIN_LEVEL ELOG_TRACE
+#endif
+
+#define JKL_LOG(category, level, ...) do { \
+        if ((level) >= JKL_LOG_MIN_LEVEL && (level) >= jklLogLevels[(category)]) \
+            jkllogWrite((category), (level), __VA_ARGS__); \
+    } while (0)
+#define JKL_TRACE(category, ...) JKL_LOG(category, ELOG_TRACE, __VA_ARGS__)
+#define JKL_DEBUG(category, ...) JKL_LOG(category, ELOG_DEBUG, __VA_ARGS__)
+#define JKL_INFO(category, ...) JKL_LOG(category, ELOG_INFO, __VA_ARGS__)
+#define JKL_WARN(category, ...) JKL_LOG(category, ELOG_WARN, __VA_ARGS__)
+#define JKL_ERROR(category, ...) JKL_LOG(category, ELOG_ERROR, __VA_ARGS__)
+
+// one ring slot. Messages longer than text are split over consecutive records, queued together so
+// they reach the sinks back to back, or are dropped together when the ring is full
+struct JklLogRecord {
+    double time;            // seconds since the logger was first used
+    uint8_t category;
+    uint8_t level;
+    uint8_t continued;      // continues the previous record's message
+    uint8_t more;           // the message continues in the next record
+    uint8_t length;
+    char text[235];
+};
+
+// lowest level written per category, ELOG_INFO by default
+extern ELOG_LEVEL jklLogLevels[ELOG_CATEGORY_COUNT];
+
+void jkllogStart(void);
+// writes out everything queued and joins the logger thread
+void jkllogStop(void);
+// blocks until every record queued so far has reached the sinks
+void jkllogFlush(void);
+
+void jkllogWrite(ELOG_CATEGORY category, ELOG_LEVEL level, const char* format, ...)
+#ifdef __GNUC__
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+
+// sinks run on the logger thread, add them before jkllogStart
+void jkllogAddSink(std::function<void(const JklLogRecord&)> sink);
+bool jkllogOpenFile(const char* path);
+void jkllogSetLevel(ELOG_CATEGORY category, ELOG_LEVEL level);
+// records lost to a full ring
+unsigned long long jkllogDropped(void);
+
+const char* jkllogCategoryName(ELOG_CATEGORY category);
+const char* jkllogLevelName(ELOG_LEVEL level);
+
+#endif
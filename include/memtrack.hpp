@@ -0,0 +1,72 @@
+#ifndef _MEMTRACK_HPP_
+#define _MEMTRACK_HPP_
+
+// Heap allocation counting. Builds with -DJKL_PROFILE replace the global operator new and count
+// every call, so per frame heap traffic can be watched and kept at zero once a scene is loaded.
+// Other builds keep the standard operator new and the counter stays at zero.
+//
+// Builds with -DJKL_MEMTRACK (make Memtrack) go further: every allocation carries a 16 byte
+// header with its size and the tag that was current on the allocating thread, so live bytes,
+// peak and allocation counts are known per subsystem. JKL_MEM_TAG(EMEM_MESH) makes a tag current
+// for the rest of the enclosing block; the innermost tag wins, so textures loaded by a model are
+// counted as textures. Memory is credited back to the tag it was allocated under, whichever
+// thread frees it. jklmemEndFrame feeds each tag's allocations per frame and live KB to the
+// profiler as counters and jklmemReport logs the totals.
+//
+// Only operator new is seen. Decoded pixels come from the image staging pool (malloc) and
+// assimp's importer allocates with new but frees everything before loadModel returns, so
+// textures show their containers and loading shows as churn, not live bytes.
+
+enum EMEM_TAG {
+    EMEM_UNTAGGED,
+    EMEM_ANIMATION,
+    EMEM_MESH,
+    EMEM_LEVEL,
+    EMEM_TEXTURE,
+    EMEM_SHADER,
+    EMEM_SCENE,
+    EMEM_TAG_COUNT
+};
+
+struct JklMemTagStats {
+    unsigned long long allocations = 0;
+    // every byte allocated under the tag, freed or not
+    unsigned long long bytes = 0;
+    long long live = 0;
+    long long peak = 0;
+};
+
+// operator new calls so far on every thread
+unsigned long long jklHeapAllocations(void);
+// false when the build doesn't count
+bool jklHeapCounting(void);
+
+// false unless built with JKL_MEMTRACK, the tag functions then do nothing
+bool jklmemTracking(void);
+// makes tag current on the calling thread and returns the previous one
+EMEM_TAG jklmemSetTag(EMEM_TAG tag);
+const char* jklmemTagName(EMEM_TAG tag);
+JklMemTagStats jklmemStats(EMEM_TAG tag);
+// once per frame on the GL thread, before jklprofileEndFrame
+void jklmemEndFrame(void);
+// logs live, peak and total allocations of every tag, biggest peak first
+void jklmemReport(void);
+
+struct JklMemTagScope {
+    EMEM_TAG previous;
+    explicit JklMemTagScope(EMEM_TAG tag) : previous(jklmemSetTag(tag)) {};
+    ~JklMemTagScope(void) { jklmemSetTag(previous); };
+
+    JklMemTagScope(const JklMemTagScope&) = delete;
+    JklMemTagScope& operator=(const JklMemTagScope&) = delete;
+};
+
+#define JKL_MEM_CONCAT2(a, b) a##b
+#define JKL_MEM_CONCAT(a, b) JKL_MEM_CONCAT2(a, b)
+#ifdef JKL_MEMTRACK
+#define JKL_MEM_TAG(tag) JklMemTagScope JKL_MEM_CONCAT(jklMemTag, __LINE__)(tag)
+#else
+#define JKL_MEM_TAG(tag) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef _OCCLUSION_HPP_
+#define _OCCLUSION_HPP_
+
+#include "culling.hpp"
+
+#include <vector>
+
+// CPU software occlusion culling. Occluder triangles (level walls and floors) are rasterized into a
+// small depth buffer, then object bounds are tested against it before their draw is submitted.
+// Everything runs on the CPU, no GL context is needed.
+//
+// The buffer keeps the farthest depth of every TILE x TILE block as well, so most tests are
+// answered from a handful of tiles and only touch pixels on the border of an occluder.
+// Rasterization splits the screen into horizontal bands, run as jobs on the job system (one per
+// worker by default), and uses SSE to shade four pixels per step.
+//
+// Depth is window depth in [0, 1], 0 at the near plane, the buffer clears to 1.
+class JklOcclusionBuffer {
+public:
+    static const int TILE = 8;
+
+    // width and height are rounded up to multiples of TILE
+    JklOcclusionBuffer(int width = 256, int height = 128);
+
+    // starts a frame, drops last frame's occluders
+    void begin(const glm::mat4& viewProjection);
+    // triangle list, three points per triangle, stride in bytes between points. Triangles
+    // crossing the near plane are clipped to it
+    void addOccluder(const glm::vec3* points, size_t count, const glm::mat4& transform, size_t stride = sizeof(glm::vec3));
+    // rasterizes every occluder added since begin(), bands <= 0 picks one per job worker
+    void rasterize(int bands = 0);
+
+    // false when the world space box is hidden behind the rasterized occluders
+    bool testAabb(const JklAabb& box) const;
+
+    int width(void) const { return bufferWidth; };
+    int height(void) const { return bufferHeight; };
+    const float* depth(void) const { return depthBuffer.data(); };
+    size_t triangleCount(void) const { return triangles.size(); };
+
+private:
+    struct Triangle {
+        float x[3], y[3], z[3];     // window space
+        int minY, maxY;             // pixel rows covered
+    };
+
+    int bufferWidth, bufferHeight;
+    int tilesX, tilesY;
+    glm::mat4 viewProjection;
+    std::vector<float> depthBuffer;
+    std::vector<float> tileMax;
+    std::vector<Triangle> triangles;
+
+    // one triangle in clip space, already on the visible side of the near plane
+    void addClipped(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void rasterizeBand(int y0, int y1);
+    void rasterizeTriangle(const Triangle& tri, int y0, int y1);
+    void updateTiles(int y0, int y1);
+};
+
+#endif
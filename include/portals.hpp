@@ -0,0 +1,71 @@
+#ifndef _PORTALS_HPP_
+#define _PORTALS_HPP_
+
+#include "culling.hpp"
+#include "arena.hpp"
+
+#include <string>
+#include <vector>
+
+// Cells and portals for indoor levels. A level is divided into convex cells (boxes) joined by
+// portals, convex polygons on the openings between them. Visibility starts in the camera's cell
+// and follows the portals, narrowing the screen region it looks through to each portal it passes,
+// so only cells that can actually be seen are drawn no matter how large the level is.
+//
+// Cells come from a .jkp text file next to the .jkl, or are generated on a grid: two neighbouring
+// grid cells get a portal over the part of their shared face that level geometry doesn't block.
+//
+//   # comment
+//   cell <min x y z> <max x y z>
+//   portal <cell> <cell> <point count> <x y z>...
+
+struct JklPortal {
+    int cells[2];
+    std::vector<glm::vec3> points;  // convex, in order
+};
+
+struct JklCell {
+    JklAabb box;
+    JklAabb drawBounds;         // the triangles sorted into the cell, they may stick out of box
+    int first = 0;              // first vertex of the cell's triangles after sorting
+    int count = 0;              // vertex count
+    std::vector<int> portals;
+    std::vector<int> overlaps;  // cells whose triangles reach into this one
+};
+
+class JklCellGraph {
+public:
+    // cell visits per query, per cell. Past it the walk stops and the rest is frustum culled
+    static const int MAX_WIDENINGS = 16;
+    static const int FACE_SAMPLES = 8;      // per side, when testing shared faces for openings
+    // a portal is one convex opening, a file with more points is corrupt
+    static const int MAX_PORTAL_POINTS = 64;
+
+    std::vector<JklCell> cells;
+    std::vector<JklPortal> portals;
+
+    bool empty(void) const { return cells.empty(); };
+
+    bool load(const char* path);
+    bool save(const char* path) const;
+
+    // grid of cubes cellSize wide over a triangle list (three points per triangle)
+    void generate(const glm::vec3* points, size_t count, float cellSize);
+    // sorts the triangles into cells, fills first/count/drawBounds/overlaps and returns the new
+    // triangle order: order[i] is the original index of the i-th triangle
+    std::vector<int> assignTriangles(const glm::vec3* points, size_t count);
+
+    // first cell containing point, -1 outside every cell
+    int findCell(const glm::vec3& point) const;
+    // cells visible from eye, both arguments in the space of the cells. The walk allocates from
+    // the frame arena and gives it back before returning
+    void visibleCells(const glm::vec3& eye, const glm::mat4& viewProjection, JklFrameVector<int>& out) const;
+
+private:
+    void link(void);
+};
+
+// path with its extension replaced, "level.jkl" + ".jkp" -> "level.jkp"
+std::string jklSidecarPath(const std::string& path, const char* extension);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _PROFILER_HPP_
+#define _PROFILER_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frame profiler. JKL_PROFILE_SCOPE("name") times the rest of the enclosing block on the CPU,
+// JKL_GPU_SCOPE("name") times the GL commands issued in it with a GL_TIME_ELAPSED query. Both
+// compile to nothing unless the engine is built with -DJKL_PROFILE (make Profile), so the markers
+// can stay in hot code. Names must be string literals, only the pointer is kept.
+//
+// Scopes append to a buffer owned by their thread and take no shared lock. jklprofileEndFrame(),
+// called by the engine once per rendered frame on the GL thread, collects every thread's buffer
+// into rolling per-scope statistics and, between jklprofileBeginCapture and jklprofileEndCapture,
+// into a capture that is written as Chrome trace JSON (open it in chrome://tracing or Perfetto).
+//
+// GPU queries are read back jklProfileGpuLatency frames after they were issued so reading them
+// never stalls on the GPU. TIME_ELAPSED queries can't nest, a GPU scope opened inside another is
+// ignored. GPU scopes only work on the thread owning the context.
+
+// rolling statistics of one scope over its last jklProfileWindow samples, in milliseconds.
+// Counters are in their own unit
+struct JklProfileStats {
+    std::string name;
+    bool gpu = false;
+    bool counter = false;
+    int samples = 0;
+    double mean = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+extern int jklProfileWindow;
+extern int jklProfileGpuLatency;
+
+struct JklProfileScope {
+    const char* name;
+    int64_t start;
+    explicit JklProfileScope(const char* name);
+    ~JklProfileScope(void);
+};
+
+struct JklGpuScope {
+    int query;
+    explicit JklGpuScope(const char* name);
+    ~JklGpuScope(void);
+};
+
+#define JKL_PROFILE_CONCAT2(a, b) a##b
+#define JKL_PROFILE_CONCAT(a, b) JKL_PROFILE_CONCAT2(a, b)
+#ifdef JKL_PROFILE
+#define JKL_PROFILE_SCOPE(name) JklProfileScope JKL_PROFILE_CONCAT(jklProfileScope, __LINE__)(name)
+#define JKL_GPU_SCOPE(name) JklGpuScope JKL_PROFILE_CONCAT(jklGpuScope, __LINE__)(name)
+#else
+#define JKL_PROFILE_SCOPE(name) do {} while (0)
+#define JKL_GPU_SCOPE(name) do {} while (0)
+#endif
+
+// names the calling thread in captures, "thread N" otherwise
+void jklprofileThreadName(const char* name);
+// GL thread, once per frame after the last GPU scope
+void jklprofileEndFrame(void);
+// records one sample of a value that isn't a time, such as allocations per frame. Counters get
+// the same rolling statistics as scopes and a counter track in captures, any thread
+void jklprofileCounter(const char* name, double value);
+// frees the GPU queries, GL thread, before the context goes away
+void jklprofileShutdown(void);
+
+void jklprofileBeginCapture(void);
+bool jklprofileCapturing(void);
+// writes everything recorded since jklprofileBeginCapture, false if the file can't be written
+bool jklprofileEndCapture(const char* path);
+
+// false when the scope has no samples yet
+bool jklprofileStats(const char* name, JklProfileStats& out, bool gpu = false);
+std::vector<JklProfileStats> jklprofileAllStats(void);
+// the scope's samples in the window, oldest first
+bool jklprofileSamples(const char* name, std::vector<double>& out, bool gpu = false);
+// drops every scope's samples, e.g. once loading is over
+void jklprofileResetStats(void);
+// logs every scope's statistics, slowest mean first, then the counters
+void jklprofileReport(void);
+
+#endif
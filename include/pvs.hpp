@@ -0,0 +1,61 @@
+#ifndef _PVS_HPP_
+#define _PVS_HPP_
+
+#include "culling.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Precomputed potentially visible sets. The level is cut into a grid of cells and jkpvs stores,
+// for every cell, which cells hold geometry visible from somewhere inside it. At runtime the
+// camera's cell is a grid lookup and its row is the whole visibility query.
+//
+// Rows are bitsets (bit c = cell c) compressed by zero runs: non zero bytes are stored as they
+// are, a zero byte is followed by how many zero bytes it stands for. Cells with identical rows
+// share one copy. The .jkv file next to the .jkl holds
+//
+//   "JKV2", int dims[3], float cellSize, float origin[3], uint64 level size, uint64 level hash,
+//   uint32 data size, uint32 row offset per cell, compressed rows
+//
+// Level size and hash are jklLevelFingerprint of the .jkl it was built from. The rows index that
+// level's triangles, so a .jkv whose level has changed since is rejected.
+//
+// The grid has the same cell order as JklCellGraph::generate: x fastest, then y, then z.
+class JklPvs {
+public:
+    glm::vec3 origin = glm::vec3(0.0f);
+    float cellSize = 0.0f;
+    int dims[3] = {0, 0, 0};
+    // jklLevelFingerprint of the level the rows were built for
+    uint64_t levelSize = 0;
+    uint64_t levelHash = 0;
+
+    bool empty(void) const { return offsets.empty(); };
+    int cellCount(void) const { return dims[0] * dims[1] * dims[2]; };
+    size_t rowBytes(void) const { return ((size_t)cellCount() + 7) / 8; };
+    size_t compressedBytes(void) const { return data.size(); };
+
+    // grid of cubes cellSize wide starting at bounds.min, drops any rows
+    void setGrid(const JklAabb& bounds, float cellSize);
+    JklAabb cellBox(int cell) const;
+    // cell containing point, -1 outside the grid
+    int cellAt(const glm::vec3& point) const;
+
+    // replaces every row, bits holds rowBytes() bytes per cell
+    void compress(const std::vector<uint8_t>& bits);
+    // false for a missing or broken file, or one built from another version of levelPath
+    bool load(const char* path, const char* levelPath);
+    bool save(const char* path) const;
+
+    // cells visible from cell, ascending. The last row asked for is kept decompressed, so this
+    // costs nothing while the camera stays in a cell. Not thread safe
+    const std::vector<int>& visibleCells(int cell) const;
+
+private:
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t> data;
+    mutable int cachedCell = -1;
+    mutable std::vector<int> cached;
+};
+
+#endif
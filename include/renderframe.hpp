@@ -0,0 +1,129 @@
+#ifndef _RENDERFRAME_HPP_
+#define _RENDERFRAME_HPP_
+
+#include "arena.hpp"
+
+#include <glm/glm.hpp>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+#include "mingw.mutex.h"
+#include "mingw.condition_variable.h"
+#endif
+
+#ifdef __linux__
+#include <mutex>
+#include <condition_variable>
+#endif
+
+// Everything the render thread needs to draw one frame, built by the game thread in codeFrame.
+// Commands run in order on the thread owning the GL context and may only read the frame and
+// what they captured by value: by the time they run the game thread is already simulating the
+// next frame. Streamed asset calls (acquire, jklstream*, chunk updates) belong in commands too,
+// the streamer is driven from the render thread.
+//
+// A recorded command is copied into the frame's own arena, which lives as long as the frame
+// buffer and is reset when the buffer is reused. Once the arena and the command list have grown
+// to a frame's worth, recording costs no heap allocation, whatever the lambda captures.
+struct JklFrame {
+    struct Command {
+        void* callable;
+        void (*invoke)(void* callable, const JklFrame& frame);
+        // nullptr when the captures have nothing to destroy
+        void (*destroy)(void* callable);
+    };
+
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 eye = glm::vec3(0.0f);
+    unsigned long long tick = 0;
+    // transforms and bone palettes copied out of game state, commands refer to them by index
+    std::vector<glm::mat4> matrices;
+    std::vector<Command> commands;
+    // the game thread waits for this frame to be drawn before simulating on. For scenes whose
+    // commands read live game state, like the default codeFrame running codeLoop
+    bool serial = false;
+
+    JklFrame(void) : arena(4096) {};
+    ~JklFrame(void) { clear(); };
+
+    JklFrame(const JklFrame&) = delete;
+    JklFrame& operator=(const JklFrame&) = delete;
+
+    void clear(void) {
+        for (Command& command : commands)
+            if (command.destroy)
+                command.destroy(command.callable);
+        commands.clear();
+        arena.reset();
+        matrices.clear();
+        serial = false;
+    };
+    // command is any callable taking the frame, usually a lambda
+    template<typename F>
+    void record(F&& command) {
+        typedef typename std::decay<F>::type Callable;
+        Command recorded;
+        recorded.callable = new (arena.allocate(sizeof(Callable), alignof(Callable))) Callable(std::forward<F>(command));
+        recorded.invoke = [](void* callable, const JklFrame& frame) { (*static_cast<Callable*>(callable))(frame); };
+        recorded.destroy = nullptr;
+        if (!std::is_trivially_destructible<Callable>::value)
+            recorded.destroy = [](void* callable) { static_cast<Callable*>(callable)->~Callable(); };
+        commands.push_back(recorded);
+    };
+    // copies count matrices and returns the index of the first
+    size_t pushMatrices(const glm::mat4* data, size_t count) {
+        size_t first = matrices.size();
+        matrices.insert(matrices.end(), data, data + count);
+        return first;
+    };
+    void execute(void) const {
+        for (const Command& command : commands)
+            command.invoke(command.callable, *this);
+    };
+
+private:
+    // the captures of this frame's commands, not a thread's frame arena: the frame is recorded on
+    // the game thread and executed on the render thread
+    JklArena arena;
+};
+
+// Hands frames from the game thread to the render thread through a ring of buffers. With two the
+// game thread fills frame N+1 while frame N is drawn, three give it one more frame of slack at
+// the cost of a frame of latency. Frames are drawn in the order they were submitted.
+class JklFramePipeline {
+public:
+    static const int MAX_BUFFERS = 3;
+
+    explicit JklFramePipeline(int buffers = 2);
+
+    // game thread: the next free frame, cleared. Blocks while every buffer is queued or drawing
+    JklFrame& beginFrame(void);
+    // game thread: queues the frame from beginFrame
+    void submitFrame(void);
+
+    // render thread: the oldest submitted frame, nullptr once stopped
+    const JklFrame* acquireFrame(void);
+    // render thread: gives the frame from acquireFrame back to the game thread
+    void releaseFrame(void);
+
+    // game thread: blocks until every submitted frame has been drawn
+    void finish(void);
+    // wakes both sides, acquireFrame returns nullptr from then on
+    void stop(void);
+
+private:
+    JklFrame frames[MAX_BUFFERS];
+    bool ready[MAX_BUFFERS] = {false, false, false};
+    int count;
+    int writeIndex = 0;
+    int readIndex = 0;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable signal;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef _SCENEINDEX_HPP_
+#define _SCENEINDEX_HPP_
+
+#include "graphics.hpp"
+#include "bvh.hpp"
+#include "occlusion.hpp"
+
+// Spatial index over everything a scene draws. Levels (StaticMesh) and models are added with a
+// transform, their object space bounds are placed in world space and kept in a JklBvh, so a
+// frame only touches the objects the frustum query returns instead of testing each one.
+// Adding objects rebuilds the tree on the next update(), moving them only refits it.
+
+enum ESCENE_OBJECT {
+    ESCENE_STATICMESH,
+    ESCENE_MODEL
+};
+
+class JklSceneIndex {
+public:
+    JklSceneIndex(void) {};
+
+    // the index only references the meshes, they have to outlive it
+    int addStaticMesh(StaticMesh* mesh, const glm::mat4& transform = glm::mat4(1.0f)) {
+        return add(ESCENE_STATICMESH, mesh, mesh->bounds, transform);
+    };
+    int addModel(Model* model, const glm::mat4& transform = glm::mat4(1.0f)) {
+        return add(ESCENE_MODEL, model, model->bounds, transform);
+    };
+
+    void setTransform(int id, const glm::mat4& transform) {
+        objects[id].transform = transform;
+        if (!rebuild)
+            tree.update(id, objects[id].local.transformed(transform));
+    };
+    const glm::mat4& transform(int id) const { return objects[id].transform; };
+
+    // call once per frame before querying
+    void update(void) {
+        if (rebuild) {
+            std::vector<JklAabb> boxes(objects.size());
+            for (size_t i = 0; i < objects.size(); i++)
+                boxes[i] = objects[i].local.transformed(objects[i].transform);
+            tree.build(boxes);
+            rebuild = false;
+        }
+        else
+            tree.refit();
+    };
+
+    // objects whose placed bounds pass the frustum, valid until the next query. Rejected objects
+    // are counted in jklCullStats, the caller records the ones it draws
+    const std::vector<int>& cull(const glm::mat4& viewProjection) {
+        visible.clear();
+        tree.queryFrustum(JklFrustum(viewProjection), visible);
+        int rejected = (int)(objects.size() - visible.size());
+        jklCullStats.tested += rejected;
+        jklCullStats.culled += rejected;
+        return visible;
+    };
+
+    // cull() first, then the level meshes that survived are rasterized into occlusion as occluders
+    // and every other candidate is tested against the result. Meshes whose CPU geometry was
+    // dropped don't occlude, see jklKeepCpuGeometry
+    const std::vector<int>& cull(const glm::mat4& viewProjection, JklOcclusionBuffer& occlusion) {
+        cull(viewProjection);
+        occlusion.begin(viewProjection);
+        for (int id : visible) {
+            StaticMesh* mesh = staticMesh(id);
+            if (mesh && !mesh->vertices.empty())
+                occlusion.addOccluder((const glm::vec3*)mesh->vertices.data(), mesh->vertices.size() / StaticMesh::STRIDE,
+                    objects[id].transform, StaticMesh::STRIDE * sizeof(float));
+        }
+        occlusion.rasterize();
+
+        size_t kept = 0;
+        for (int id : visible) {
+            // an occluder can't hide itself
+            StaticMesh* mesh = staticMesh(id);
+            if ((mesh && !mesh->vertices.empty()) || occlusion.testAabb(tree.objectBounds(id)))
+                visible[kept++] = id;
+            else {
+                jklCullStats.record(false);
+                jklCullStats.occluded++;
+            }
+        }
+        visible.resize(kept);
+        return visible;
+    };
+
+    // draws what cull() returns, models still cull their meshes one by one. StaticMesh draws with
+    // the shader it was uploaded with, models with the one given
+    void draw(Shader& shader, const glm::mat4& viewProjection) {
+        JklFrustum frustum(viewProjection);
+        for (int id : cull(viewProjection)) {
+            Object& object = objects[id];
+            if (object.type == ESCENE_STATICMESH) {
+                jklCullStats.record(true);
+                staticMesh(id)->DrawTransformed(object.transform);
+            }
+            else {
+                shader.setMat4("model", object.transform);
+                model(id)->Draw(shader, frustum, object.transform);
+            }
+        }
+    };
+
+    ESCENE_OBJECT type(int id) const { return objects[id].type; };
+    StaticMesh* staticMesh(int id) const { return objects[id].type == ESCENE_STATICMESH ? (StaticMesh*)objects[id].pointer : nullptr; };
+    Model* model(int id) const { return objects[id].type == ESCENE_MODEL ? (Model*)objects[id].pointer : nullptr; };
+
+    const JklBvh& bvh(void) const { return tree; };
+    size_t size(void) const { return objects.size(); };
+
+private:
+    struct Object {
+        ESCENE_OBJECT type;
+        void* pointer;
+        JklAabb local;
+        glm::mat4 transform;
+    };
+
+    std::vector<Object> objects;
+    std::vector<int> visible;
+    JklBvh tree;
+    bool rebuild = false;
+
+    int add(ESCENE_OBJECT type, void* pointer, const JklAabb& local, const glm::mat4& transform) {
+        objects.push_back(Object{type, pointer, local, transform});
+        rebuild = true;
+        return (int)objects.size() - 1;
+    };
+};
+
+#endif
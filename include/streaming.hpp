@@ -0,0 +1,125 @@
+#ifndef _STREAMING_HPP_
+#define _STREAMING_HPP_
+
+#include "graphics.hpp"
+#include "textures.hpp"
+#include "lockfree.hpp"
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+// Asynchronous asset loading. Loader threads do the file I/O, image decoding and mesh building,
+// then hand the finished CPU data to the GL thread as upload packets through a lock-free queue.
+// jklstreamPump() drains that queue once per frame inside a time and byte budget, so loading
+// a level never freezes the window. Handles stay valid for the life of the streamer and flip
+// to resident once their last packet has been uploaded.
+//
+// When started with an upload context (a hidden window sharing objects with the main one) the
+// packets are instead uploaded by a dedicated thread owning that context. It fences each upload
+// and the render thread only runs the cheap finish step (VAO setup) once the fence has signalled.
+//
+// Resident assets are kept under jklGpuBudgetBytes. Scenes call acquire() on the assets they draw
+// each frame; when jklstreamEndFrame() finds the budget exceeded it evicts the least recently
+// acquired ones, and the next acquire() of an evicted asset loads it again from disk. Nothing
+// inside an asset may be touched while it isn't resident.
+
+enum EASSET_STATE {
+    EASSET_QUEUED,
+    EASSET_LOADING,
+    EASSET_UPLOADING,
+    EASSET_RESIDENT,
+    EASSET_FAILED,
+    EASSET_EVICTED
+};
+
+struct JklAsset {
+    std::string path;
+    std::atomic<int> state;
+    std::atomic<int> pendingUploads;
+    std::function<void(void)> loader;   // the load job, queued again after an eviction
+    size_t gpuBytes = 0;                // summed from the upload packets
+    unsigned long long lastUsedFrame = 0;
+
+    JklAsset(const std::string& path) : path(path), state(EASSET_QUEUED), pendingUploads(0) {};
+    virtual ~JklAsset(void) {};
+
+    bool resident(void) const { return state.load(std::memory_order_acquire) == EASSET_RESIDENT; };
+    bool failed(void) const { return state.load(std::memory_order_acquire) == EASSET_FAILED; };
+
+    // marks the asset as drawn this frame and reloads it if it was evicted, returns resident()
+    bool acquire(void);
+    // frees the GPU objects and the CPU copies, render thread only
+    virtual void evict(void) = 0;
+};
+
+struct JklTextureAsset : JklAsset {
+    Texture texture = 0;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+    JklImage image;
+    JklCookedTexture cooked;    // used instead of image for .jkt files
+
+    JklTextureAsset(const std::string& path) : JklAsset(path) {};
+    void evict(void) override;
+};
+
+struct JklStaticMeshAsset : JklAsset {
+    StaticMesh mesh;
+    Shader* shader = nullptr;
+
+    JklStaticMeshAsset(const std::string& path) : JklAsset(path) {};
+    void evict(void) override;
+};
+
+struct JklModelAsset : JklAsset {
+    Model model;
+    Animation animation;
+    bool animated = false;
+
+    JklModelAsset(const std::string& path) : JklAsset(path) {};
+    void evict(void) override;
+};
+
+// a unit of GL work produced by a loader thread, bytes is what it costs against the frame budget.
+// upload only creates shareable objects (buffers, textures) so it may run on the upload context,
+// finish always runs on the render thread after the upload is complete.
+struct JklUploadPacket {
+    size_t bytes;
+    std::function<void(void)> upload;
+    std::function<void(void)> finish;
+    GLsync fence;
+};
+
+// per frame upload budget, at least one packet is always uploaded so loading can't stall
+extern float jklStreamBudgetMs;
+extern size_t jklStreamBudgetBytes;
+// GPU memory resident streamed assets may use before the least recently drawn are evicted
+extern size_t jklGpuBudgetBytes;
+
+// workers = 0 starts a loader for each core the job system doesn't use, 1 to 4. uploadContext = a
+// window sharing objects with the render context, enables the upload thread
+void jklstreamStart(int workers = 0, GLFWwindow* uploadContext = nullptr);
+void jklstreamStop(void);
+
+JklTextureAsset* jklstreamTexture(const char* path, GLint minFilter = GL_LINEAR_MIPMAP_LINEAR, GLint magFilter = GL_LINEAR);
+// materialLayers is handed to the mesh before its load is queued, see StaticMesh::materialLayers
+JklStaticMeshAsset* jklstreamStaticMesh(const char* path, Shader* shader, const std::vector<int>& materialLayers = std::vector<int>());
+JklModelAsset* jklstreamModel(const char* path, bool animated = false);
+
+// runs on the render thread, uploads queued packets until the budget is spent,
+// or with an upload thread finishes every packet whose fence has signalled
+void jklstreamPump(void);
+// true when nothing is queued, loading or waiting for upload
+bool jklstreamIdle(void);
+// advances the frame clock used by acquire() and evicts assets until the budget is met.
+// assets acquired in the frame that just ended are never evicted
+void jklstreamEndFrame(void);
+// bytes held by resident streamed assets
+size_t jklstreamResidentBytes(void);
+// evicts a resident asset now rather than waiting for the budget, false while it is still loading.
+// The handle stays valid and acquire() loads it again
+bool jklstreamRelease(JklAsset* asset);
+
+#endif
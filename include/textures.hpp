@@ -0,0 +1,107 @@
+#ifndef _TEXTURES_HPP_
+#define _TEXTURES_HPP_
+
+#include <glad/glad.h>
+#include "images.hpp"
+
+#include <string>
+#include <vector>
+
+// S3TC isn't core in 3.3 so the generated loader doesn't define its enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT   0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT  0x83F3
+#endif
+
+// texture last bound to unit 0 by the calling thread's context, so meshes sharing a texture or a
+// texture array bind it once. Every glBindTexture has to update it; the render thread resets it
+// each frame. One per thread since every thread has its own context
+extern thread_local unsigned int LastTextureBound;
+
+// Model::loadModel and jklstreamModel put a model's textures in texture array layers instead of
+// one 2D texture each, drawn with texflatarray.fs. Off by default, set before loading models
+extern bool jklModelTextureArrays;
+
+// Ring of pixel unpack buffers used to stream texture data. Each upload orphans the next buffer
+// in the ring and maps it write-only, so the copy never waits on a transfer the GPU is still doing
+// and glTexImage2D returns without touching client memory. One ring exists per thread/context.
+class JklPboRing {
+public:
+    JklPboRing(void) {};
+
+    // stages count bytes and leaves the buffer bound to GL_PIXEL_UNPACK_BUFFER, texture calls
+    // then take offsets into it instead of pointers. Call unbind() once they are issued.
+    // False when the buffer couldn't be mapped: nothing is bound and the caller uploads straight
+    // from the chunk pointers instead
+    bool stage(const void* const* chunks, const size_t* sizes, int count);
+    void unbind(void);
+
+private:
+    static const int RING_SIZE = 4;
+    GLuint buffers[RING_SIZE] = {0};
+    int next = 0;
+};
+
+// Packs textures of the same size and channel count into GL_TEXTURE_2D_ARRAY layers, so meshes
+// using different textures can be drawn back to back with a single bind and a layer index.
+// add() may run on any thread, build() needs the GL context. Groups are split when they reach
+// the 256 layer minimum GL 3.3 guarantees.
+class JklTextureArraySet {
+public:
+    static const int MAX_LAYERS = 256;
+
+    JklTextureArraySet(void) {};
+    // deletes the array textures, meshes still pointing at them must not be drawn afterwards
+    ~JklTextureArraySet(void);
+
+    // takes ownership of the decoded image, keys already present are ignored
+    void add(const std::string& key, JklImage&& image);
+    bool contains(const std::string& key) const;
+
+    // uploads every group with its mip chain and frees the CPU copies
+    void build(GLint minFilter = GL_LINEAR_MIPMAP_LINEAR, GLint magFilter = GL_LINEAR);
+
+    // array texture and layer a key ended up in, valid after build()
+    bool find(const std::string& key, unsigned int& array, int& layer) const;
+    size_t arrayCount(void) const { return groups.size(); };
+    // CPU bytes of the images still waiting for build()
+    size_t pendingBytes(void) const;
+
+private:
+    struct Entry {
+        std::string key;
+        JklImage image;
+        int group;
+        int layer;
+    };
+    struct Group {
+        int width, height, channels;
+        int layers;
+        unsigned int array;
+    };
+    std::vector<Entry> entries;
+    std::vector<Group> groups;
+};
+
+// GL pixel format matching a channel count (1 = RED, 2 = RG, 3 = RGB, 4 = RGBA)
+GLenum jklImageFormat(int channels);
+bool jklFilterUsesMips(GLint minFilter);
+// GL_EXT_texture_compression_s3tc, queried once from the current context
+bool jklHasS3TC(void);
+
+// creates a 2D texture from decoded data through the calling thread's PBO ring, must run on a thread
+// with a current GL context. Uploads the precomputed mip chain when the image has one.
+unsigned int jklUploadImage(const JklImage& image, GLint minFilter = GL_LINEAR_MIPMAP_LINEAR, GLint magFilter = GL_LINEAR);
+
+// uploads every level of a .jkt as is, block compressed levels go through glCompressedTexImage2D.
+// Without S3TC support the blocks are expanded to RGBA8 on the CPU first.
+unsigned int jklUploadCookedTexture(const JklCookedTexture& texture, GLint minFilter = GL_LINEAR_MIPMAP_LINEAR, GLint magFilter = GL_LINEAR);
+
+// decode, mip and upload in one go for synchronous loads, .jkt files are uploaded directly
+unsigned int jklLoadTexture(const char* path, GLint minFilter = GL_LINEAR_MIPMAP_LINEAR, GLint magFilter = GL_LINEAR);
+
+bool jklIsCookedTexturePath(const char* path);
+
+#endif
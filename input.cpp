@@ -0,0 +1,221 @@
+#include "include/input.hpp"
+#include "include/engineinit.hpp"
+#include "include/log.hpp"
+#include "include/lockfree.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+JklInputSnapshot jklLiveInput;
+bool jklReplayExit = false;
+
+// snapshots are written to recordings as they are
+static_assert(sizeof(JklInputSnapshot) == 16, "JklInputSnapshot is the .jki tick layout");
+
+static JklMpmcQueue<JklInputEvent> events(1024);
+static std::atomic<unsigned long long> droppedEvents(0);
+
+// the action each key and mouse button is bound to, 0 when unbound
+static uint32_t keyBindings[GLFW_KEY_LAST + 1];
+static uint32_t mouseBindings[GLFW_MOUSE_BUTTON_LAST + 1];
+static bool keyDown[GLFW_KEY_LAST + 1];
+static bool mouseDown[GLFW_MOUSE_BUTTON_LAST + 1];
+// bound keys down per action bit, an action is held while any of its keys is
+static int heldKeys[32];
+static bool haveCursor = false;
+static double cursorX = 0.0, cursorY = 0.0;
+
+static bool recording = false;
+static std::string recordPath;
+static std::vector<JklInputSnapshot> recorded;
+
+static bool replaying = false;
+static std::vector<JklInputSnapshot> replay;
+static size_t replayTick = 0;
+
+static int actionBit(uint32_t button) {
+    for (int bit = 0; bit < 32; bit++)
+        if (button == (1u << bit))
+            return bit;
+    return -1;
+}
+
+// counts the keys that are down again, only needed when bindings change
+static void recountHeld(void) {
+    for (int& count : heldKeys)
+        count = 0;
+    for (int key = 0; key <= GLFW_KEY_LAST; key++)
+        if (keyDown[key] && keyBindings[key])
+            heldKeys[actionBit(keyBindings[key])]++;
+    for (int button = 0; button <= GLFW_MOUSE_BUTTON_LAST; button++)
+        if (mouseDown[button] && mouseBindings[button])
+            heldKeys[actionBit(mouseBindings[button])]++;
+}
+
+static struct DefaultBindings {
+    DefaultBindings(void) {
+        keyBindings[GLFW_KEY_W] = EINPUT_UP;
+        keyBindings[GLFW_KEY_D] = EINPUT_RIGHT;
+        keyBindings[GLFW_KEY_S] = EINPUT_DOWN;
+        keyBindings[GLFW_KEY_A] = EINPUT_LEFT;
+        keyBindings[GLFW_KEY_J] = EINPUT_ACTION;
+    }
+} defaultBindings;
+
+void jklinputBind(int code, EINPUT_BUTTON button, bool mouse) {
+    if (actionBit(button) < 0)
+        return;
+    if (mouse && code >= 0 && code <= GLFW_MOUSE_BUTTON_LAST)
+        mouseBindings[code] = button;
+    else if (!mouse && code >= 0 && code <= GLFW_KEY_LAST)
+        keyBindings[code] = button;
+    recountHeld();
+}
+
+void jklinputUnbind(int code, bool mouse) {
+    if (mouse && code >= 0 && code <= GLFW_MOUSE_BUTTON_LAST)
+        mouseBindings[code] = 0;
+    else if (!mouse && code >= 0 && code <= GLFW_KEY_LAST)
+        keyBindings[code] = 0;
+    recountHeld();
+}
+
+bool jklinputPushEvent(const JklInputEvent& event) {
+    if (events.push(event))
+        return true;
+    droppedEvents++;
+    return false;
+}
+
+// a press or release of a key or mouse button, repeats change nothing
+static void applyButton(bool* down, const uint32_t* bindings, int code, int action, uint32_t& pressed) {
+    if (action == GLFW_REPEAT || down[code] == (action == GLFW_PRESS))
+        return;
+    down[code] = action == GLFW_PRESS;
+    if (!bindings[code])
+        return;
+    heldKeys[actionBit(bindings[code])] += down[code] ? 1 : -1;
+    if (down[code])
+        pressed |= bindings[code];
+}
+
+JklInputSnapshot jklinputConsume(void) {
+    JklInputSnapshot live;
+    uint32_t pressed = 0;
+    JklInputEvent event;
+    while (events.pop(event)) {
+        switch (event.type) {
+        case EINPUT_KEY:
+            if (event.code >= 0 && event.code <= GLFW_KEY_LAST)
+                applyButton(keyDown, keyBindings, event.code, event.action, pressed);
+            break;
+        case EINPUT_MOUSE_BUTTON:
+            if (event.code >= 0 && event.code <= GLFW_MOUSE_BUTTON_LAST)
+                applyButton(mouseDown, mouseBindings, event.code, event.action, pressed);
+            break;
+        case EINPUT_CURSOR:
+            // the first position only sets where movement is measured from
+            if (haveCursor) {
+                live.lookX += (float)(event.x - cursorX);
+                live.lookY += (float)(event.y - cursorY);
+            }
+            haveCursor = true;
+            cursorX = event.x;
+            cursorY = event.y;
+            break;
+        case EINPUT_SCROLL:
+            live.scroll += (float)event.y;
+            break;
+        }
+    }
+    // pressed since the last tick counts even when already released again
+    live.buttons = pressed;
+    for (int bit = 0; bit < 32; bit++)
+        if (heldKeys[bit] > 0)
+            live.buttons |= 1u << bit;
+    unsigned long long dropped = droppedEvents.exchange(0);
+    if (dropped > 0)
+        JKL_WARN(ELOG_INPUT, "%llu input events dropped, the queue was full", dropped);
+    jklLiveInput = live;
+    return live;
+}
+
+JklInputSnapshot jklinputTick(const JklInputSnapshot& live) {
+    JklInputSnapshot input = live;
+    if (replaying) {
+        input = replay[replayTick++];
+        if (replayTick == replay.size()) {
+            replaying = false;
+            JKL_INFO(ELOG_INPUT, "replay finished after %zu ticks", replay.size());
+        }
+    }
+    if (recording)
+        recorded.push_back(input);
+    return input;
+}
+
+bool jklinputRecord(const char* path) {
+    recordPath = path;
+    recorded.clear();
+    recording = true;
+    return true;
+}
+
+bool jklinputReplay(const char* path) {
+    std::ifstream infile(path, std::ios::binary);
+    char magic[4];
+    float tickRate = 0.0f;
+    uint32_t count = 0;
+    infile.read(magic, 4);
+    infile.read(reinterpret_cast<char*>(&tickRate), sizeof(tickRate));
+    infile.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!infile || memcmp(magic, "JKI2", 4) != 0 || count == 0 || count > (1u << 24)) {
+        JKL_ERROR(ELOG_INPUT, "ERROR::JKI::INVALID_FILE: %s", path);
+        return false;
+    }
+    std::vector<JklInputSnapshot> ticks(count);
+    infile.read(reinterpret_cast<char*>(ticks.data()), count * sizeof(JklInputSnapshot));
+    if (!infile) {
+        JKL_ERROR(ELOG_INPUT, "ERROR::JKI::TRUNCATED: %s", path);
+        return false;
+    }
+    // the same input at another tick rate moves things a different distance per tick
+    if (std::fabs(tickRate - jklTickRate) > 1e-3f)
+        JKL_WARN(ELOG_INPUT, "%s was recorded at %.2f ticks per second, replaying at %.2f", path, tickRate, jklTickRate);
+    replay.swap(ticks);
+    replayTick = 0;
+    replaying = true;
+    JKL_INFO(ELOG_INPUT, "replaying %u ticks from %s", count, path);
+    return true;
+}
+
+bool jklinputRecording(void) {
+    return recording;
+}
+
+bool jklinputReplaying(void) {
+    return replaying;
+}
+
+bool jklinputStop(void) {
+    replaying = false;
+    if (!recording)
+        return true;
+    recording = false;
+    std::ofstream outfile(recordPath, std::ios::binary);
+    uint32_t count = (uint32_t)recorded.size();
+    outfile.write("JKI2", 4);
+    outfile.write(reinterpret_cast<const char*>(&jklTickRate), sizeof(jklTickRate));
+    outfile.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    outfile.write(reinterpret_cast<const char*>(recorded.data()), recorded.size() * sizeof(JklInputSnapshot));
+    if (!outfile) {
+        JKL_ERROR(ELOG_INPUT, "ERROR::JKI::NOT_WRITTEN: %s", recordPath.c_str());
+        return false;
+    }
+    JKL_INFO(ELOG_INPUT, "recorded %u ticks to %s", count, recordPath.c_str());
+    return true;
+}
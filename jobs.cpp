@@ -0,0 +1,318 @@
+#include "include/jobs.hpp"
+#include "include/lockfree.hpp"
+#include "include/log.hpp"
+#include "include/profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#ifdef _WIN32
+#include "include/mingw.thread.h"
+#include "include/mingw.condition_variable.h"
+#endif
+
+#ifdef __linux__
+#include <thread>
+#include <condition_variable>
+#endif
+
+struct JklJob {
+    std::function<void(void)> work;
+    JklJobCounter* counter;
+    bool pooled;
+};
+
+// jobs are recycled through a fixed pool shared by every thread, so queueing one costs no heap
+// allocation (parallel loops run every frame). Past the pool they come from the heap
+static const int JOB_POOL_SIZE = 4096;
+static JklJob jobPool[JOB_POOL_SIZE];
+
+struct alignas(64) JklWorker {
+    JklWorkStealingDeque<JklJob*> deque;
+    std::thread thread;
+    std::atomic<unsigned long long> jobs;
+    std::atomic<unsigned long long> steals;
+    std::atomic<long long> busyNanoseconds;
+    unsigned int random;
+
+    JklWorker(unsigned int seed) : deque(4096), jobs(0), steals(0), busyNanoseconds(0), random(seed) {};
+};
+
+static std::vector<std::unique_ptr<JklWorker>> workers;
+// jobs queued by threads that aren't workers
+static JklMpmcQueue<JklJob*> injected(4096);
+static thread_local int workerIndex = -1;
+// jobs run while waiting inside a job nest, only the outermost one is timed
+static thread_local int executeDepth = 0;
+
+// sleeping workers wake when queued goes above zero
+static std::atomic<int> queued(0);
+static std::atomic<int> sleeping(0);
+static std::atomic<bool> stopping(false);
+static std::mutex sleepMutex;
+static std::condition_variable sleepSignal;
+static std::chrono::steady_clock::time_point statsStart = std::chrono::steady_clock::now();
+
+static void execute(JklJob* job);
+
+static JklMpmcQueue<JklJob*>& freeJobs(void) {
+    static JklMpmcQueue<JklJob*> queue(JOB_POOL_SIZE);
+    static bool filled = [] {
+        for (JklJob& job : jobPool) {
+            job.pooled = true;
+            queue.push(&job);
+        }
+        return true;
+    }();
+    (void)filled;
+    return queue;
+}
+
+static JklJob* newJob(std::function<void(void)>&& work, JklJobCounter* counter) {
+    JklJob* job = nullptr;
+    if (!freeJobs().pop(job)) {
+        job = new JklJob();
+        job->pooled = false;
+    }
+    job->work = std::move(work);
+    job->counter = counter;
+    return job;
+}
+
+static void recycleJob(JklJob* job) {
+    // the captures go now, not when the slot is reused
+    job->work = nullptr;
+    if (job->pooled)
+        freeJobs().push(job);
+    else
+        delete job;
+}
+
+static void wake(void) {
+    if (sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepSignal.notify_one();
+    }
+}
+
+static void schedule(JklJob* job) {
+    // with no worker threads, a job queued from outside would wait until the starting thread
+    // waits on a counter
+    if (workers.empty() || (workers.size() == 1 && workerIndex < 0)) {
+        execute(job);
+        return;
+    }
+    queued.fetch_add(1);
+    bool pushed = workerIndex >= 0 ? workers[workerIndex]->deque.push(job) : injected.push(job);
+    if (!pushed) {
+        // every queue is full, running it here is still correct
+        queued.fetch_sub(1);
+        execute(job);
+        return;
+    }
+    wake();
+}
+
+struct JklJobAccess {
+    static void add(JklJobCounter* counter) {
+        if (counter != nullptr)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void finish(JklJobCounter* counter) {
+        if (counter == nullptr || counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        std::vector<JklJob*> ready;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            ready.swap(counter->waiting);
+        }
+        for (JklJob* job : ready)
+            schedule(job);
+    }
+
+    // false when the dependency is still pending, the job then runs from its finish()
+    static bool readyOrWait(JklJobCounter& dependency, JklJob* job) {
+        // finish() takes the list under the same lock, so the job is either seen there or here
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (dependency.pending.load(std::memory_order_acquire) == 0)
+            return true;
+        dependency.waiting.push_back(job);
+        return false;
+    }
+};
+
+static void execute(JklJob* job) {
+    auto begin = std::chrono::steady_clock::now();
+    executeDepth++;
+    job->work();
+    executeDepth--;
+    if (workerIndex >= 0) {
+        JklWorker& worker = *workers[workerIndex];
+        if (executeDepth == 0) {
+            auto spent = std::chrono::steady_clock::now() - begin;
+            worker.busyNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(spent).count(), std::memory_order_relaxed);
+        }
+        worker.jobs.fetch_add(1, std::memory_order_relaxed);
+    }
+    JklJobCounter* counter = job->counter;
+    recycleJob(job);
+    JklJobAccess::finish(counter);
+}
+
+static JklJob* findJob(void) {
+    JklJob* job = nullptr;
+    if (workerIndex >= 0 && workers[workerIndex]->deque.pop(job)) {
+        queued.fetch_sub(1);
+        return job;
+    }
+    if (injected.pop(job)) {
+        queued.fetch_sub(1);
+        return job;
+    }
+    // steal, starting from a random victim so thieves spread out
+    size_t count = workers.size();
+    unsigned int start = 0;
+    if (workerIndex >= 0) {
+        unsigned int& random = workers[workerIndex]->random;
+        random = random * 1664525u + 1013904223u;
+        start = random >> 8;
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t victim = (start + i) % count;
+        if ((int)victim == workerIndex)
+            continue;
+        if (workers[victim]->deque.steal(job)) {
+            queued.fetch_sub(1);
+            if (workerIndex >= 0)
+                workers[workerIndex]->steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+static void workerMain(int index) {
+    workerIndex = index;
+#ifdef JKL_PROFILE
+    jklprofileThreadName(("worker " + std::to_string(index)).c_str());
+#endif
+    for (;;) {
+        JklJob* job = findJob();
+        if (job != nullptr) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1);
+        sleepSignal.wait(lock, [] { return stopping.load() || queued.load() > 0; });
+        sleeping.fetch_sub(1);
+        if (stopping.load() && queued.load() == 0)
+            return;
+    }
+}
+
+void jkljobStart(int count) {
+    if (!workers.empty())
+        return;
+    if (count <= 0)
+        count = std::max((int)std::thread::hardware_concurrency() - 1, 0);
+    stopping.store(false);
+    workers.reserve(count + 1);
+    for (int i = 0; i <= count; i++)
+        workers.emplace_back(new JklWorker(0x9E3779B9u * (i + 1)));
+    workerIndex = 0;
+    for (int i = 1; i <= count; i++)
+        workers[i]->thread = std::thread(workerMain, i);
+    jkljobResetStats();
+}
+
+void jkljobStop(void) {
+    if (workers.empty())
+        return;
+    // worker 0 is the caller, drain what only it may pop
+    while (JklJob* job = findJob())
+        execute(job);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping.store(true);
+        sleepSignal.notify_all();
+    }
+    for (size_t i = 1; i < workers.size(); i++)
+        workers[i]->thread.join();
+    workers.clear();
+    workerIndex = -1;
+}
+
+int jkljobWorkerCount(void) {
+    return std::max((int)workers.size(), 1);
+}
+
+void jkljobRun(std::function<void(void)> work, JklJobCounter* counter) {
+    JklJobAccess::add(counter);
+    schedule(newJob(std::move(work), counter));
+}
+
+void jkljobRunAfter(JklJobCounter& dependency, std::function<void(void)> work, JklJobCounter* counter) {
+    JklJobAccess::add(counter);
+    JklJob* job = newJob(std::move(work), counter);
+    if (JklJobAccess::readyOrWait(dependency, job))
+        schedule(job);
+}
+
+void jkljobWait(JklJobCounter& counter) {
+    while (!counter.done()) {
+        JklJob* job = findJob();
+        if (job != nullptr)
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void jkljobParallelFor(int begin, int end, int grain, const std::function<void(int first, int last)>& body) {
+    if (end <= begin)
+        return;
+    grain = std::max(grain, 1);
+    if (workers.size() <= 1 || end - begin <= grain) {
+        body(begin, end);
+        return;
+    }
+    JklJobCounter counter;
+    // the caller keeps the first range, the rest go to whoever is free
+    for (int first = begin + grain; first < end; first += grain) {
+        int last = std::min(first + grain, end);
+        jkljobRun([&body, first, last] { body(first, last); }, &counter);
+    }
+    body(begin, std::min(begin + grain, end));
+    jkljobWait(counter);
+}
+
+std::vector<JklWorkerStats> jkljobStats(void) {
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - statsStart).count();
+    std::vector<JklWorkerStats> stats(workers.size());
+    for (size_t i = 0; i < workers.size(); i++) {
+        stats[i].jobs = workers[i]->jobs.load(std::memory_order_relaxed);
+        stats[i].steals = workers[i]->steals.load(std::memory_order_relaxed);
+        stats[i].busySeconds = workers[i]->busyNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        stats[i].utilization = wall > 0.0 ? stats[i].busySeconds / wall : 0.0;
+    }
+    return stats;
+}
+
+void jkljobResetStats(void) {
+    for (auto& worker : workers) {
+        worker->jobs.store(0, std::memory_order_relaxed);
+        worker->steals.store(0, std::memory_order_relaxed);
+        worker->busyNanoseconds.store(0, std::memory_order_relaxed);
+    }
+    statsStart = std::chrono::steady_clock::now();
+}
+
+void jkljobReport(void) {
+    std::vector<JklWorkerStats> stats = jkljobStats();
+    for (size_t i = 0; i < stats.size(); i++)
+        JKL_INFO(ELOG_JOBS, "worker %d : %llu jobs, %llu steals, %d%% busy", (int)i, stats[i].jobs, stats[i].steals,
+            (int)(stats[i].utilization * 100.0 + 0.5));
+}
@@ -0,0 +1,80 @@
+#include "include/levelchunks.hpp"
+#include "include/log.hpp"
+
+#include <algorithm>
+
+static float distanceToBox(const JklAabb& box, const glm::vec3& point) {
+    glm::vec3 outside = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.0f));
+    return glm::length(outside);
+}
+
+bool JklChunkedLevel::load(const char* path, Shader* levelShader) {
+    std::vector<JklLevelChunkInfo> list;
+    if (!jklReadChunkList(path, list))
+        return false;
+    shader = levelShader;
+    chunks.clear();
+    chunks.resize(list.size());
+    for (size_t i = 0; i < list.size(); i++)
+        chunks[i].info = list[i];
+    return true;
+}
+
+void JklChunkedLevel::update(const glm::vec3& eye, const glm::mat4& model) {
+    glm::vec3 localEye = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.0f));
+    float unload = unloadRadius > 0.0f ? std::max(unloadRadius, prefetchRadius) : prefetchRadius * 1.25f;
+    for (JklLevelChunk& chunk : chunks) {
+        float distance = distanceToBox(chunk.info.bounds, localEye);
+        if (distance <= prefetchRadius)
+            chunk.wanted = true;
+        else if (distance > unload)
+            chunk.wanted = false;
+
+        if (chunk.wanted) {
+            bool queued = chunk.asset == nullptr || chunk.asset->state.load(std::memory_order_acquire) == EASSET_EVICTED;
+            // acquire() also keeps the chunk off the budget's eviction list
+            if (chunk.asset == nullptr)
+                chunk.asset = jklstreamStaticMesh(chunk.info.path.c_str(), shader, materialLayers);
+            else
+                chunk.asset->acquire();
+            if (queued) {
+                loads++;
+                JKL_DEBUG(ELOG_ASSET, "chunk %s in range, loading", chunk.info.path.c_str());
+            }
+        }
+        // a chunk still loading is released on a later update
+        else if (chunk.asset != nullptr && jklstreamRelease(chunk.asset)) {
+            releases++;
+            JKL_DEBUG(ELOG_ASSET, "chunk %s out of range, released", chunk.info.path.c_str());
+        }
+    }
+}
+
+void JklChunkedLevel::draw(const glm::vec3& eye, const glm::mat4& viewProjection, const glm::mat4& model) {
+    JklFrustum frustum(viewProjection * model);
+    for (JklLevelChunk& chunk : chunks) {
+        if (chunk.asset == nullptr || !chunk.asset->resident())
+            continue;
+        if (!jklCullStats.record(frustum.testAabb(chunk.info.bounds)))
+            continue;
+        chunk.asset->mesh.DrawVisible(eye, viewProjection, model);
+    }
+}
+
+int JklChunkedLevel::residentChunks(void) const {
+    int count = 0;
+    for (const JklLevelChunk& chunk : chunks)
+        count += chunk.asset != nullptr && chunk.asset->resident();
+    return count;
+}
+
+int JklChunkedLevel::pendingChunks(void) const {
+    int count = 0;
+    for (const JklLevelChunk& chunk : chunks) {
+        if (chunk.asset == nullptr)
+            continue;
+        int state = chunk.asset->state.load(std::memory_order_acquire);
+        count += state == EASSET_QUEUED || state == EASSET_LOADING || state == EASSET_UPLOADING;
+    }
+    return count;
+}
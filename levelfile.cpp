@@ -0,0 +1,238 @@
+#include "include/levelfile.hpp"
+#include "include/log.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+template<typename T>
+static bool readValue(std::ifstream& in, T& value) {
+    return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static void writeValue(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+bool jklReadLevel(const char* path, JklLevelData& level) {
+    std::ifstream infile(path, std::ios::binary);
+    if (!infile) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::LEVEL::FILE_NOT_FOUND: %s", path);
+        return false;
+    }
+    level = JklLevelData();
+    infile.seekg(0, std::ios::end);
+    const uint64_t fileBytes = (uint64_t)infile.tellg();
+    infile.seekg(0, std::ios::beg);
+
+    int vcnt, uvcnt, ncnt, tricnt, mtlcnt;
+    if (!readValue(infile, vcnt) || !readValue(infile, uvcnt) || !readValue(infile, ncnt)
+        || !readValue(infile, tricnt) || !readValue(infile, mtlcnt)
+        || vcnt < 0 || uvcnt < 0 || ncnt < 0 || tricnt < 0 || mtlcnt < 0) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::LEVEL::BAD_HEADER: %s", path);
+        return false;
+    }
+    // a corrupt count would otherwise size the tables below, check them against what the file holds
+    const uint64_t headerBytes = 5 * sizeof(int);
+    const uint64_t tableBytes = (uint64_t)vcnt * sizeof(vert) + (uint64_t)uvcnt * sizeof(txc) + (uint64_t)ncnt * sizeof(vert)
+        + (uint64_t)tricnt * (sizeof(uint8_t) + 9 * sizeof(int)) + (uint64_t)mtlcnt * (sizeof(uint8_t) + 3 * sizeof(float));
+    if (tableBytes > fileBytes - headerBytes) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::LEVEL::BAD_HEADER: %s: counts need %llu bytes, the file has %llu",
+            path, (unsigned long long)(tableBytes + headerBytes), (unsigned long long)fileBytes);
+        return false;
+    }
+
+    // counts are known up front, size everything once instead of growing per element
+    level.points.resize(vcnt);
+    level.uvs.resize(uvcnt);
+    level.normals.resize(ncnt);
+    level.triangles.reserve(tricnt);
+    level.materials.reserve(mtlcnt);
+
+    // the tables are plain float arrays
+    infile.read(reinterpret_cast<char*>(level.points.data()), sizeof(vert) * vcnt);
+    infile.read(reinterpret_cast<char*>(level.uvs.data()), sizeof(txc) * uvcnt);
+    infile.read(reinterpret_cast<char*>(level.normals.data()), sizeof(vert) * ncnt);
+
+    for (int i = 0; i < tricnt && infile; i++) {
+        uint8_t matid;
+        trindex tri;
+        readValue(infile, matid);
+        readValue(infile, tri.vt1);
+        readValue(infile, tri.uv1);
+        readValue(infile, tri.vn1);
+        readValue(infile, tri.vt2);
+        readValue(infile, tri.uv2);
+        readValue(infile, tri.vn2);
+        readValue(infile, tri.vt3);
+        readValue(infile, tri.uv3);
+        readValue(infile, tri.vn3);
+        tri.matid = matid;
+        level.triangles.push_back(tri);
+    }
+
+    for (int i = 0; i < mtlcnt && infile; i++) {
+        uint8_t texuse;
+        float rr, gg, bb;
+        readValue(infile, texuse);
+        readValue(infile, rr);
+        readValue(infile, gg);
+        readValue(infile, bb);
+        level.materials.push_back((mat){rr, gg, bb, texuse != 0, 0});
+    }
+
+    if (!infile) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::LEVEL::TRUNCATED: %s", path);
+        return false;
+    }
+
+    for (const trindex& tri : level.triangles) {
+        bool inRange = tri.matid < mtlcnt
+            && tri.vt1 >= 0 && tri.vt1 < vcnt && tri.vt2 >= 0 && tri.vt2 < vcnt && tri.vt3 >= 0 && tri.vt3 < vcnt
+            && tri.uv1 >= 0 && tri.uv1 < uvcnt && tri.uv2 >= 0 && tri.uv2 < uvcnt && tri.uv3 >= 0 && tri.uv3 < uvcnt
+            && tri.vn1 >= 0 && tri.vn1 < ncnt && tri.vn2 >= 0 && tri.vn2 < ncnt && tri.vn3 >= 0 && tri.vn3 < ncnt;
+        if (!inRange) {
+            JKL_ERROR(ELOG_ASSET, "ERROR::LEVEL::BAD_INDEX: %s", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool jklWriteLevel(const char* path, const JklLevelData& level) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        return false;
+    writeValue(out, (int)level.points.size());
+    writeValue(out, (int)level.uvs.size());
+    writeValue(out, (int)level.normals.size());
+    writeValue(out, (int)level.triangles.size());
+    writeValue(out, (int)level.materials.size());
+    out.write(reinterpret_cast<const char*>(level.points.data()), sizeof(vert) * level.points.size());
+    out.write(reinterpret_cast<const char*>(level.uvs.data()), sizeof(txc) * level.uvs.size());
+    out.write(reinterpret_cast<const char*>(level.normals.data()), sizeof(vert) * level.normals.size());
+    for (const trindex& tri : level.triangles) {
+        writeValue(out, (uint8_t)tri.matid);
+        writeValue(out, tri.vt1);
+        writeValue(out, tri.uv1);
+        writeValue(out, tri.vn1);
+        writeValue(out, tri.vt2);
+        writeValue(out, tri.uv2);
+        writeValue(out, tri.vn2);
+        writeValue(out, tri.vt3);
+        writeValue(out, tri.uv3);
+        writeValue(out, tri.vn3);
+    }
+    for (const mat& material : level.materials) {
+        writeValue(out, (uint8_t)(material.tex ? 1 : 0));
+        writeValue(out, material.r);
+        writeValue(out, material.g);
+        writeValue(out, material.b);
+    }
+    return (bool)out;
+}
+
+bool jklLevelFingerprint(const char* path, uint64_t& size, uint64_t& hash) {
+    std::ifstream infile(path, std::ios::binary);
+    if (!infile)
+        return false;
+    // FNV-1a
+    size = 0;
+    hash = 14695981039346656037ull;
+    char buffer[16384];
+    while (infile.read(buffer, sizeof(buffer)) || infile.gcount() > 0) {
+        std::streamsize got = infile.gcount();
+        for (std::streamsize i = 0; i < got; i++)
+            hash = (hash ^ (uint8_t)buffer[i]) * 1099511628211ull;
+        size += (uint64_t)got;
+    }
+    return true;
+}
+
+void jklLevelPositions(const JklLevelData& level, std::vector<glm::vec3>& out) {
+    out.reserve(out.size() + level.triangles.size() * 3);
+    for (const trindex& tri : level.triangles) {
+        const vert& a = level.points[tri.vt1];
+        const vert& b = level.points[tri.vt2];
+        const vert& c = level.points[tri.vt3];
+        out.push_back(glm::vec3(a.x, a.y, a.z));
+        out.push_back(glm::vec3(b.x, b.y, b.z));
+        out.push_back(glm::vec3(c.x, c.y, c.z));
+    }
+}
+
+void jklExtractLevel(const JklLevelData& level, const std::vector<int>& triangles, JklLevelData& out) {
+    out = JklLevelData();
+    out.materials = level.materials;
+    out.triangles.reserve(triangles.size());
+    // -1 until an index is first used, then its slot in out
+    std::vector<int> pointMap(level.points.size(), -1), uvMap(level.uvs.size(), -1), normalMap(level.normals.size(), -1);
+    auto remap = [](int index, std::vector<int>& map, auto& from, auto& to) {
+        if (map[index] < 0) {
+            map[index] = (int)to.size();
+            to.push_back(from[index]);
+        }
+        return map[index];
+    };
+    for (int t : triangles) {
+        trindex tri = level.triangles[t];
+        tri.vt1 = remap(tri.vt1, pointMap, level.points, out.points);
+        tri.vt2 = remap(tri.vt2, pointMap, level.points, out.points);
+        tri.vt3 = remap(tri.vt3, pointMap, level.points, out.points);
+        tri.uv1 = remap(tri.uv1, uvMap, level.uvs, out.uvs);
+        tri.uv2 = remap(tri.uv2, uvMap, level.uvs, out.uvs);
+        tri.uv3 = remap(tri.uv3, uvMap, level.uvs, out.uvs);
+        tri.vn1 = remap(tri.vn1, normalMap, level.normals, out.normals);
+        tri.vn2 = remap(tri.vn2, normalMap, level.normals, out.normals);
+        tri.vn3 = remap(tri.vn3, normalMap, level.normals, out.normals);
+        out.triangles.push_back(tri);
+    }
+}
+
+bool jklReadChunkList(const char* path, std::vector<JklLevelChunkInfo>& chunks) {
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    chunks.clear();
+    std::string directory(path);
+    size_t slash = directory.find_last_of("/\\");
+    directory = slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream in(line);
+        std::string keyword;
+        if (!(in >> keyword) || keyword[0] == '#')
+            continue;
+        JklLevelChunkInfo chunk;
+        glm::vec3 lo, hi;
+        if (keyword != "chunk" || !(in >> chunk.path >> lo.x >> lo.y >> lo.z >> hi.x >> hi.y >> hi.z)) {
+            JKL_ERROR(ELOG_ASSET, "ERROR::LEVEL::BAD_CHUNK_LIST: %s:%d", path, lineNumber);
+            chunks.clear();
+            return false;
+        }
+        chunk.path = directory + chunk.path;
+        chunk.bounds.expand(lo);
+        chunk.bounds.expand(hi);
+        chunks.push_back(chunk);
+    }
+    return true;
+}
+
+bool jklWriteChunkList(const char* path, const std::vector<JklLevelChunkInfo>& chunks) {
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    // enough digits that the bounds read back exactly
+    file << std::setprecision(9) << "# written by jkcook level\n";
+    for (const JklLevelChunkInfo& chunk : chunks) {
+        const glm::vec3& lo = chunk.bounds.min;
+        const glm::vec3& hi = chunk.bounds.max;
+        file << "chunk " << chunk.path << " " << lo.x << " " << lo.y << " " << lo.z << " " << hi.x << " " << hi.y << " " << hi.z << "\n";
+    }
+    return (bool)file;
+}
@@ -0,0 +1,198 @@
+#include "include/log.hpp"
+#include "include/lockfree.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#ifdef _WIN32
+#include "include/mingw.thread.h"
+#include "include/mingw.mutex.h"
+#include "include/mingw.condition_variable.h"
+#endif
+
+#ifdef __linux__
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+ELOG_LEVEL jklLogLevels[ELOG_CATEGORY_COUNT] = {ELOG_INFO, ELOG_INFO, ELOG_INFO, ELOG_INFO, ELOG_INFO, ELOG_INFO, ELOG_INFO, ELOG_INFO};
+
+static JklMpmcQueue<JklLogRecord> ring(4096);
+static std::thread logger;
+static std::atomic<bool> running(false);
+static std::atomic<bool> stopping(false);
+static std::atomic<unsigned long long> pushed(0);
+static std::atomic<unsigned long long> written(0);
+static std::atomic<unsigned long long> dropped(0);
+// the logger only sleeps this long, so producers never need a lock to wake it
+static std::mutex wakeMutex;
+static std::condition_variable wakeSignal;
+
+// sinks are only touched by the logger thread once it runs, the mutex covers the synchronous path
+static std::vector<std::function<void(const JklLogRecord&)>> sinks;
+static std::mutex sinkMutex;
+static std::vector<FILE*> files;
+
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+const char* jkllogCategoryName(ELOG_CATEGORY category) {
+    static const char* names[ELOG_CATEGORY_COUNT] = {"engine", "input", "render", "asset", "memory", "jobs", "game", "profile"};
+    return category >= 0 && category < ELOG_CATEGORY_COUNT ? names[category] : "?";
+}
+
+const char* jkllogLevelName(ELOG_LEVEL level) {
+    static const char* names[ELOG_OFF] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+    return level >= 0 && level < ELOG_OFF ? names[level] : "?";
+}
+
+// "[   12.345] INFO  render: text", continuation records carry only their text
+static void writeRecord(FILE* out, const JklLogRecord& record) {
+    if (!record.continued)
+        fprintf(out, "[%9.3f] %-5s %s: ", record.time, jkllogLevelName((ELOG_LEVEL)record.level),
+            jkllogCategoryName((ELOG_CATEGORY)record.category));
+    fwrite(record.text, 1, record.length, out);
+    if (!record.more)
+        fputc('\n', out);
+}
+
+static void consoleSink(const JklLogRecord& record) {
+    writeRecord(stdout, record);
+}
+
+static void deliver(const JklLogRecord& record) {
+    if (sinks.empty())
+        consoleSink(record);
+    for (auto& sink : sinks)
+        sink(record);
+}
+
+static void flushSinks(void) {
+    fflush(stdout);
+    for (FILE* file : files)
+        fflush(file);
+}
+
+static void loggerMain(void) {
+    JklLogRecord record;
+    for (;;) {
+        bool any = false;
+        while (ring.pop(record)) {
+            deliver(record);
+            written.fetch_add(1, std::memory_order_release);
+            any = true;
+        }
+        if (any)
+            flushSinks();
+        if (stopping.load(std::memory_order_acquire) && ring.size() == 0)
+            return;
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeSignal.wait_for(lock, std::chrono::milliseconds(5));
+    }
+}
+
+void jkllogStart(void) {
+    if (running.exchange(true))
+        return;
+    stopping.store(false);
+    logger = std::thread(loggerMain);
+}
+
+void jkllogStop(void) {
+    if (!running.load())
+        return;
+    stopping.store(true, std::memory_order_release);
+    wakeSignal.notify_one();
+    logger.join();
+    running.store(false);
+    flushSinks();
+}
+
+void jkllogFlush(void) {
+    if (!running.load()) {
+        std::lock_guard<std::mutex> lock(sinkMutex);
+        flushSinks();
+        return;
+    }
+    unsigned long long target = pushed.load(std::memory_order_acquire);
+    wakeSignal.notify_one();
+    while (written.load(std::memory_order_acquire) < target)
+        std::this_thread::yield();
+}
+
+void jkllogWrite(ELOG_CATEGORY category, ELOG_LEVEL level, const char* format, ...) {
+    char buffer[2048];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0)
+        return;
+    length = std::min(length, (int)sizeof(buffer) - 1);
+
+    // split up front, so the whole message takes its slots in one go and other threads' records
+    // can't land between its parts
+    const int recordText = (int)sizeof(JklLogRecord::text);
+    JklLogRecord records[(sizeof(buffer) + recordText - 1) / recordText];
+    double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+    int count = 0;
+    int offset = 0;
+    do {
+        JklLogRecord& record = records[count++];
+        int part = std::min(length - offset, recordText);
+        record.time = time;
+        record.category = (uint8_t)category;
+        record.level = (uint8_t)level;
+        record.continued = offset > 0;
+        record.length = (uint8_t)part;
+        memcpy(record.text, buffer + offset, part);
+        offset += part;
+        record.more = offset < length;
+    } while (offset < length);
+
+    bool async = running.load(std::memory_order_acquire);
+    if (!async) {
+        std::lock_guard<std::mutex> lock(sinkMutex);
+        for (int i = 0; i < count; i++)
+            deliver(records[i]);
+        flushSinks();
+    }
+    else if (ring.pushAll(records, count))
+        pushed.fetch_add(count, std::memory_order_release);
+    else
+        dropped.fetch_add(count, std::memory_order_relaxed);
+    // errors are worth waking the logger for, the rest waits for its next poll
+    if (async && level >= ELOG_ERROR)
+        wakeSignal.notify_one();
+}
+
+void jkllogAddSink(std::function<void(const JklLogRecord&)> sink) {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    if (sinks.empty())
+        sinks.push_back(consoleSink);
+    sinks.push_back(std::move(sink));
+}
+
+bool jkllogOpenFile(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(sinkMutex);
+        files.push_back(file);
+    }
+    jkllogAddSink([file](const JklLogRecord& record) { writeRecord(file, record); });
+    return true;
+}
+
+void jkllogSetLevel(ELOG_CATEGORY category, ELOG_LEVEL level) {
+    jklLogLevels[category] = level;
+}
+
+unsigned long long jkllogDropped(void) {
+    return dropped.load(std::memory_order_relaxed);
+}
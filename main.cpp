@@ -1,11 +1,14 @@
 #include "include/engineinit.hpp"
-#define STB_IMAGE_IMPLEMENTATION
 #include "include/graphics.hpp"
+#include "include/streaming.hpp"
+#include "include/input.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <glm/gtx/string_cast.hpp>
 
 int LastThingDrawn;
@@ -23,32 +26,19 @@ Shader* CURRENT_SHADER;
 
 
 unsigned int LoadTexture(const char *filename) {
-    unsigned int texture;
-    int width, height, nrChannels;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);  
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    unsigned char *data = stbi_load(filename, &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    stbi_image_free(data);
-    return texture;
+    return jklLoadTexture(filename, GL_NEAREST_MIPMAP_LINEAR, GL_NEAREST);
 };
 
 
 typedef struct TestScene : JklScene {
 
     unsigned int texture1; 
-    Model ourModel;
-	Animation danceAnimation;
+    JklModelAsset* ourModel;
 	Animator animator;
+    bool animatorReady = false;
     int hasPrinted = 0;
+    // simulated in codeTick, camera.Position is set from it every frame
+    JklTickState<glm::vec3> cameraPosition;
 
     TestScene(void) {
 
@@ -57,53 +47,103 @@ typedef struct TestScene : JklScene {
     void codeInit(void) override {
         
         texture1 = LoadTexture("resources/grid.png");
-        	ourModel = Model("resources/SONCANIM.fbx");
-	        danceAnimation = Animation("resources/SONCANIM.fbx",&ourModel);
-	        animator = Animator(&danceAnimation);
-            animator.PlayAnimation(&danceAnimation);
+        // streamed in the background, drawn once resident
+        ourModel = jklstreamModel("resources/SONCANIM.fbx", true);
+        cameraPosition.snap(camera.Position);
     };
 
-    void codeLoop(void) override {
-        CURRENT_SHADER->use();
-        CURRENT_SHADER->setInt("texture_diffuse1",0);
-		animator.UpdateAnimation(deltaTime);		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 20000.0f);
-		glm::mat4 view = camera.GetViewMatrix();
-		CURRENT_SHADER->setMat4("projection", projection);
-		CURRENT_SHADER->setMat4("view", view);
-        if(inputdir == 0) camera.Position.z -= 1.f;
-        if(inputdir == 4) camera.Position.z += 1.f;
+    void codeTick(void) override {
+        // 60 units a second, what the old per frame step moved at 60 fps
+        const float speed = 60.f;
+        cameraPosition.tick();
+        if(inputdir == 0) cameraPosition.current.z -= speed * jklFixedDeltaTime;
+        if(inputdir == 4) cameraPosition.current.z += speed * jklFixedDeltaTime;
+    };
 
-        auto transforms = animator.GetFinalBoneMatrices();
+    // game thread: everything drawn is copied into the frame, the command only touches GL
+    void codeFrame(JklFrame& frame) override {
+        camera.Position = cameraPosition.render();
+		frame.projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 20000.0f);
+		frame.view = camera.GetViewMatrix();
+        frame.eye = camera.Position;
+        // the model is acquired by the command every frame, so once resident it stays resident
+        if (!ourModel->resident()) {
+            frame.record([this](const JklFrame&) { ourModel->acquire(); });
+            return;
+        }
+        if (!animatorReady) {
+	        animator = Animator(&ourModel->animation);
+            animator.PlayAnimation(&ourModel->animation);
+            animatorReady = true;
+        }
+		animator.UpdateAnimation(deltaTime);
+
+        const std::vector<glm::mat4>& transforms = animator.GetFinalBoneMatrices();
 
         if(hasPrinted == 0) {
           for(int i = 0; i < transforms.size(); i++)  {
-            std::cout << glm::to_string(transforms[i]) << std::endl;
+            JKL_DEBUG(ELOG_GAME, "%s", glm::to_string(transforms[i]).c_str());
           }
           hasPrinted = 1;
         };
 
-        glm::mat4 testtttt(1.f);
-		for (int i = 0; i < transforms.size(); ++i)
-			CURRENT_SHADER->setMat4("finalBonesMatrices[" + std::to_string(i) + "]", testtttt);
-
-
 		// render the loaded model
 		glm::mat4 model = glm::mat4(1.0f);
         model *= glm::eulerAngleXYZ(0.f,90.f,0.f);
 		model = glm::translate(model, glm::vec3(0.0f, -0.0f, 0.0f)); // translate it down so it's at the center of the scene
 		model = glm::scale(model, glm::vec3(1.f, 1.f, 1.f));	// it's a bit too big for our scene, so scale it down
-		CURRENT_SHADER->setMat4("model", model); 
-		ourModel.Draw(*CURRENT_SHADER);
+        size_t modelIndex = frame.pushMatrices(&model, 1);
+        int bones = (int)transforms.size();
+
+        frame.record([this, modelIndex, bones](const JklFrame& f) {
+            if (!ourModel->acquire())
+                return;
+            const glm::mat4& model = f.matrices[modelIndex];
+            CURRENT_SHADER->use();
+            CURRENT_SHADER->setInt("texture_diffuse1",0);
+            CURRENT_SHADER->setMat4("projection", f.projection);
+            CURRENT_SHADER->setMat4("view", f.view);
+
+            static const std::vector<glm::mat4> identityBones(100, glm::mat4(1.f));
+            CURRENT_SHADER->setMat4Array("finalBonesMatrices", identityBones.data(), std::min(bones, (int)identityBones.size()));
+
+            CURRENT_SHADER->setMat4("model", model); 
+            // the shader gets identity bone matrices above, so the bind pose bounds apply
+            ourModel->model.Draw(*CURRENT_SHADER, JklFrustum(f.projection * f.view), model);
+        });
     };
 };
 
-int main()
+int main(int argc, char** argv)
 {
-    jklstart(SCR_WIDTH,SCR_HEIGHT);
+    // --headless [frames] draws offscreen without a display and exits, see jklHeadless
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            jklHeadless = true;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+                jklHeadlessFrames = atoi(argv[++i]);
+        }
+        // --record file.jki keeps every tick's input, --replay file.jki plays it back and exits
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            jklinputRecord(argv[++i]);
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            if (!jklinputReplay(argv[++i]))
+                return 1;
+            jklReplayExit = true;
+        }
+        // --texture-arrays draws the model's textures from texture array layers
+        else if (strcmp(argv[i], "--texture-arrays") == 0)
+            jklModelTextureArrays = true;
+    }
+    if (!jklstart(SCR_WIDTH,SCR_HEIGHT))
+        return 1;
+    // nothing in the test scene reads mesh data back after upload
+    jklKeepCpuGeometry = false;
+    // the scene records its frames through codeFrame, so they can be drawn on their own thread
+    jklRenderThread = true;
     TestScene scenstance;
 
-    Shader ourShader("resources/texflat.vs", "resources/texflat.fs");
+    Shader ourShader("resources/texflat.vs", jklModelTextureArrays ? "resources/texflatarray.fs" : "resources/texflat.fs");
     CURRENT_SHADER = &ourShader;
 
 
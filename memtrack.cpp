@@ -0,0 +1,207 @@
+#include "include/memtrack.hpp"
+#include "include/log.hpp"
+#include "include/profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<unsigned long long> allocations(0);
+
+static const char* tagNames[EMEM_TAG_COUNT] = {"untagged", "animation", "mesh", "level", "texture", "shader", "scene"};
+// counter names for the profiler, which keeps only the pointer
+static const char* frameCounterNames[EMEM_TAG_COUNT] = {
+    "allocs untagged", "allocs animation", "allocs mesh", "allocs level", "allocs texture", "allocs shader", "allocs scene"};
+static const char* liveCounterNames[EMEM_TAG_COUNT] = {
+    "KB untagged", "KB animation", "KB mesh", "KB level", "KB texture", "KB shader", "KB scene"};
+
+unsigned long long jklHeapAllocations(void) {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+const char* jklmemTagName(EMEM_TAG tag) {
+    return tag >= 0 && tag < EMEM_TAG_COUNT ? tagNames[tag] : "invalid";
+}
+
+#ifdef JKL_MEMTRACK
+
+namespace {
+
+struct TagCounters {
+    std::atomic<unsigned long long> allocations{0};
+    std::atomic<unsigned long long> bytes{0};
+    std::atomic<long long> live{0};
+    std::atomic<long long> peak{0};
+};
+
+// in front of every tracked allocation, 16 bytes keeps the payload aligned like malloc's
+struct AllocationHeader {
+    uint64_t size;
+    uint32_t tag;
+    uint32_t pad;
+};
+
+}
+
+static TagCounters tagCounters[EMEM_TAG_COUNT];
+// plain int, so reading it from operator new never runs a thread_local constructor
+static thread_local int currentTag = EMEM_UNTAGGED;
+
+bool jklHeapCounting(void) {
+    return true;
+}
+
+bool jklmemTracking(void) {
+    return true;
+}
+
+EMEM_TAG jklmemSetTag(EMEM_TAG tag) {
+    EMEM_TAG previous = (EMEM_TAG)currentTag;
+    currentTag = tag;
+    return previous;
+}
+
+static void raisePeak(std::atomic<long long>& peak, long long value) {
+    long long seen = peak.load(std::memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+}
+
+static void* trackedAllocate(size_t size) {
+    AllocationHeader* header = (AllocationHeader*)malloc(sizeof(AllocationHeader) + size);
+    if (!header)
+        return nullptr;
+    header->size = size;
+    header->tag = (uint32_t)currentTag;
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    TagCounters& counters = tagCounters[header->tag];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+    raisePeak(counters.peak, counters.live.fetch_add((long long)size, std::memory_order_relaxed) + (long long)size);
+    return header + 1;
+}
+
+static void trackedFree(void* memory) {
+    if (!memory)
+        return;
+    AllocationHeader* header = (AllocationHeader*)memory - 1;
+    tagCounters[header->tag].live.fetch_sub((long long)header->size, std::memory_order_relaxed);
+    free(header);
+}
+
+JklMemTagStats jklmemStats(EMEM_TAG tag) {
+    JklMemTagStats stats;
+    if (tag < 0 || tag >= EMEM_TAG_COUNT)
+        return stats;
+    stats.allocations = tagCounters[tag].allocations.load(std::memory_order_relaxed);
+    stats.bytes = tagCounters[tag].bytes.load(std::memory_order_relaxed);
+    stats.live = tagCounters[tag].live.load(std::memory_order_relaxed);
+    stats.peak = tagCounters[tag].peak.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void jklmemEndFrame(void) {
+    static unsigned long long lastAllocations[EMEM_TAG_COUNT];
+    for (int tag = 0; tag < EMEM_TAG_COUNT; tag++) {
+        unsigned long long count = tagCounters[tag].allocations.load(std::memory_order_relaxed);
+        jklprofileCounter(frameCounterNames[tag], (double)(count - lastAllocations[tag]));
+        jklprofileCounter(liveCounterNames[tag], tagCounters[tag].live.load(std::memory_order_relaxed) / 1024.0);
+        lastAllocations[tag] = count;
+    }
+}
+
+void jklmemReport(void) {
+    JklMemTagStats stats[EMEM_TAG_COUNT];
+    int order[EMEM_TAG_COUNT];
+    long long live = 0;
+    for (int tag = 0; tag < EMEM_TAG_COUNT; tag++) {
+        stats[tag] = jklmemStats((EMEM_TAG)tag);
+        order[tag] = tag;
+        live += stats[tag].live;
+    }
+    std::sort(order, order + EMEM_TAG_COUNT, [&stats](int a, int b) { return stats[a].peak > stats[b].peak; });
+    JKL_INFO(ELOG_MEMORY, "Heap by tag : live %lld KB", live / 1024);
+    for (int tag : order)
+        JKL_INFO(ELOG_MEMORY, "  %-10s live %8lld KB  peak %8lld KB  %10llu allocations  %10llu KB allocated",
+            tagNames[tag], stats[tag].live / 1024, stats[tag].peak / 1024, stats[tag].allocations, stats[tag].bytes / 1024);
+}
+
+#define JKL_HEAP_ALLOCATE(size) trackedAllocate(size)
+#define JKL_HEAP_FREE(memory) trackedFree(memory)
+
+#else
+
+bool jklmemTracking(void) {
+    return false;
+}
+
+EMEM_TAG jklmemSetTag(EMEM_TAG) {
+    return EMEM_UNTAGGED;
+}
+
+JklMemTagStats jklmemStats(EMEM_TAG) {
+    return JklMemTagStats();
+}
+
+void jklmemEndFrame(void) {}
+
+void jklmemReport(void) {}
+
+#ifdef JKL_PROFILE
+
+bool jklHeapCounting(void) {
+    return true;
+}
+
+static void* countedAllocate(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+#define JKL_HEAP_ALLOCATE(size) countedAllocate(size)
+#define JKL_HEAP_FREE(memory) free(memory)
+
+#else
+
+bool jklHeapCounting(void) {
+    return false;
+}
+
+#endif
+
+#endif
+
+#ifdef JKL_HEAP_ALLOCATE
+
+// the plain and array forms, aligned new keeps the library's own allocation and delete
+void* operator new(size_t size) {
+    void* memory = JKL_HEAP_ALLOCATE(size);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    void* memory = JKL_HEAP_ALLOCATE(size);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return JKL_HEAP_ALLOCATE(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return JKL_HEAP_ALLOCATE(size);
+}
+
+void operator delete(void* memory) noexcept { JKL_HEAP_FREE(memory); }
+void operator delete[](void* memory) noexcept { JKL_HEAP_FREE(memory); }
+void operator delete(void* memory, size_t) noexcept { JKL_HEAP_FREE(memory); }
+void operator delete[](void* memory, size_t) noexcept { JKL_HEAP_FREE(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { JKL_HEAP_FREE(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { JKL_HEAP_FREE(memory); }
+
+#endif
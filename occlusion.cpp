@@ -0,0 +1,249 @@
+#include "include/occlusion.hpp"
+#include "include/jobs.hpp"
+#include "include/profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// boxes closer than this in clip w are treated as visible
+static const float NEAR_W = 1e-3f;
+
+JklOcclusionBuffer::JklOcclusionBuffer(int width, int height) {
+    tilesX = std::max((width + TILE - 1) / TILE, 1);
+    tilesY = std::max((height + TILE - 1) / TILE, 1);
+    bufferWidth = tilesX * TILE;
+    bufferHeight = tilesY * TILE;
+    depthBuffer.assign((size_t)bufferWidth * bufferHeight, 1.0f);
+    tileMax.assign((size_t)tilesX * tilesY, 1.0f);
+    viewProjection = glm::mat4(1.0f);
+}
+
+void JklOcclusionBuffer::begin(const glm::mat4& vp) {
+    viewProjection = vp;
+    triangles.clear();
+}
+
+void JklOcclusionBuffer::addOccluder(const glm::vec3* points, size_t count, const glm::mat4& transform, size_t stride) {
+    glm::mat4 mvp = viewProjection * transform;
+    const unsigned char* p = (const unsigned char*)points;
+    for (size_t i = 0; i + 2 < count; i += 3) {
+        glm::vec4 clip[3];
+        int inside = 0;
+        for (int v = 0; v < 3; v++) {
+            clip[v] = mvp * glm::vec4(*(const glm::vec3*)(p + (i + v) * stride), 1.0f);
+            inside += clip[v].z + clip[v].w >= 0.0f;
+        }
+        if (inside == 3) {
+            addClipped(clip[0], clip[1], clip[2]);
+            continue;
+        }
+        if (inside == 0)
+            continue;
+
+        // Sutherland-Hodgman against the near plane z = -w, a triangle becomes at most a quad.
+        // Projecting the part behind it instead would smear it across the screen in front of
+        // everything
+        glm::vec4 polygon[4];
+        int n = 0;
+        for (int v = 0; v < 3; v++) {
+            const glm::vec4& a = clip[v];
+            const glm::vec4& b = clip[(v + 1) % 3];
+            float da = a.z + a.w, db = b.z + b.w;
+            if (da >= 0.0f)
+                polygon[n++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                polygon[n++] = a + (b - a) * (da / (da - db));
+        }
+        for (int v = 2; v < n; v++)
+            addClipped(polygon[0], polygon[v - 1], polygon[v]);
+    }
+}
+
+void JklOcclusionBuffer::addClipped(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+    const glm::vec4* clip[3] = {&a, &b, &c};
+    Triangle tri;
+    for (int v = 0; v < 3; v++) {
+        // only projections without a near plane get here with w <= 0, nothing sensible to draw
+        if (clip[v]->w < NEAR_W)
+            return;
+        float inverseW = 1.0f / clip[v]->w;
+        tri.x[v] = (clip[v]->x * inverseW * 0.5f + 0.5f) * bufferWidth;
+        tri.y[v] = (clip[v]->y * inverseW * 0.5f + 0.5f) * bufferHeight;
+        tri.z[v] = std::max(clip[v]->z * inverseW * 0.5f + 0.5f, 0.0f);
+    }
+
+    float minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+    float maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+    float minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+    float maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+    float minZ = std::min(tri.z[0], std::min(tri.z[1], tri.z[2]));
+    // off screen or entirely beyond the far plane
+    if (maxX < 0.0f || minX >= bufferWidth || maxY < 0.0f || minY >= bufferHeight || minZ > 1.0f)
+        return;
+    tri.minY = std::max((int)std::floor(minY), 0);
+    tri.maxY = std::min((int)std::ceil(maxY), bufferHeight - 1);
+    triangles.push_back(tri);
+}
+
+void JklOcclusionBuffer::rasterize(int bands) {
+    JKL_PROFILE_SCOPE("occlusion");
+    std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+    if (bands <= 0)
+        bands = jkljobWorkerCount();
+    // bands are whole tile rows so each job also owns the tiles it updates
+    bands = std::min(bands, tilesY);
+    int bandTiles = (tilesY + bands - 1) / bands;
+
+    jkljobParallelFor(0, bands, 1, [this, bandTiles](int first, int last) {
+        for (int band = first; band < last; band++) {
+            int y0 = band * bandTiles * TILE;
+            int y1 = std::min((band + 1) * bandTiles * TILE, bufferHeight);
+            if (y0 < y1)
+                rasterizeBand(y0, y1);
+        }
+    });
+}
+
+void JklOcclusionBuffer::rasterizeBand(int y0, int y1) {
+    for (const Triangle& tri : triangles)
+        if (tri.maxY >= y0 && tri.minY < y1)
+            rasterizeTriangle(tri, y0, y1);
+    updateTiles(y0, y1);
+}
+
+void JklOcclusionBuffer::rasterizeTriangle(const Triangle& tri, int y0, int y1) {
+    float x0 = tri.x[0], ya = tri.y[0];
+    float x1 = tri.x[1], yb = tri.y[1];
+    float x2 = tri.x[2], yc = tri.y[2];
+    float area = (x1 - x0) * (yc - ya) - (x2 - x0) * (yb - ya);
+    if (std::fabs(area) < 1e-6f)
+        return;
+    // occluders have no facing, wind every triangle the same way
+    float z0 = tri.z[0], z1 = tri.z[1], z2 = tri.z[2];
+    if (area < 0.0f) {
+        std::swap(x1, x2);
+        std::swap(yb, yc);
+        std::swap(z1, z2);
+        area = -area;
+    }
+
+    // edge functions e(x, y) = a * x + b * y + c, positive inside
+    float a0 = yb - yc, b0 = x2 - x1, c0 = x1 * yc - x2 * yb;   // edge 1 -> 2, weight of vertex 0
+    float a1 = yc - ya, b1 = x0 - x2, c1 = x2 * ya - x0 * yc;   // edge 2 -> 0, weight of vertex 1
+    float a2 = ya - yb, b2 = x1 - x0, c2 = x0 * yb - x1 * ya;   // edge 0 -> 1, weight of vertex 2
+    // depth is affine in window space. The plane is anchored at vertex 0, summing the c terms
+    // instead cancels catastrophically once depths bunch up near 1
+    float inverseArea = 1.0f / area;
+    float dzdx = (a0 * z0 + a1 * z1 + a2 * z2) * inverseArea;
+    float dzdy = (b0 * z0 + b1 * z1 + b2 * z2) * inverseArea;
+    float zc = z0 - dzdx * x0 - dzdy * ya;
+
+    int minX = std::max((int)std::floor(std::min(x0, std::min(x1, x2))), 0) & ~3;
+    int maxX = std::min((int)std::ceil(std::max(x0, std::max(x1, x2))), bufferWidth - 1);
+    int rowStart = std::max(tri.minY, y0);
+    int rowEnd = std::min(tri.maxY, y1 - 1);
+
+#ifdef JKL_SSE
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 va0 = _mm_set1_ps(a0), va1 = _mm_set1_ps(a1), va2 = _mm_set1_ps(a2);
+    __m128 vdzdx = _mm_set1_ps(dzdx);
+    __m128 step0 = _mm_set1_ps(a0 * 4.0f), step1 = _mm_set1_ps(a1 * 4.0f), step2 = _mm_set1_ps(a2 * 4.0f);
+    __m128 stepZ = _mm_set1_ps(dzdx * 4.0f);
+    for (int y = rowStart; y <= rowEnd; y++) {
+        float py = y + 0.5f;
+        __m128 px = _mm_add_ps(_mm_set1_ps((float)minX), offsets);
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(va0, px), _mm_set1_ps(b0 * py + c0));
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(va1, px), _mm_set1_ps(b1 * py + c1));
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(va2, px), _mm_set1_ps(b2 * py + c2));
+        __m128 z = _mm_add_ps(_mm_mul_ps(vdzdx, px), _mm_set1_ps(dzdy * py + zc));
+        float* row = &depthBuffer[(size_t)y * bufferWidth];
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside) != 0) {
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(current, z);
+                // blend: inside lanes take the nearer depth, the others keep theirs
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+            }
+            e0 = _mm_add_ps(e0, step0);
+            e1 = _mm_add_ps(e1, step1);
+            e2 = _mm_add_ps(e2, step2);
+            z = _mm_add_ps(z, stepZ);
+        }
+    }
+#else
+    for (int y = rowStart; y <= rowEnd; y++) {
+        float py = y + 0.5f;
+        float* row = &depthBuffer[(size_t)y * bufferWidth];
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+            if (a0 * px + b0 * py + c0 < 0.0f || a1 * px + b1 * py + c1 < 0.0f || a2 * px + b2 * py + c2 < 0.0f)
+                continue;
+            float z = dzdx * px + dzdy * py + zc;
+            if (z < row[x])
+                row[x] = z;
+        }
+    }
+#endif
+}
+
+void JklOcclusionBuffer::updateTiles(int y0, int y1) {
+    for (int ty = y0 / TILE; ty < (y1 + TILE - 1) / TILE; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            float farthest = 0.0f;
+            for (int y = ty * TILE; y < (ty + 1) * TILE; y++) {
+                const float* row = &depthBuffer[(size_t)y * bufferWidth + tx * TILE];
+                for (int x = 0; x < TILE; x++)
+                    farthest = std::max(farthest, row[x]);
+            }
+            tileMax[(size_t)ty * tilesX + tx] = farthest;
+        }
+    }
+}
+
+bool JklOcclusionBuffer::testAabb(const JklAabb& box) const {
+    if (!box.valid())
+        return false;
+    float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY, minZ = INFINITY;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        // crosses the near plane, the camera may be inside it
+        if (clip.w < NEAR_W)
+            return true;
+        float inverseW = 1.0f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * bufferWidth;
+        float y = (clip.y * inverseW * 0.5f + 0.5f) * bufferHeight;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, clip.z * inverseW * 0.5f + 0.5f);
+    }
+    if (minZ <= 0.0f)
+        return true;
+    // outside the buffer is for the frustum test to decide
+    if (maxX < 0.0f || maxY < 0.0f || minX >= bufferWidth || minY >= bufferHeight)
+        return true;
+
+    // every pixel the box might touch, so the test stays conservative
+    int x0 = std::max((int)std::floor(minX), 0), x1 = std::min((int)std::ceil(maxX), bufferWidth - 1);
+    int y0 = std::max((int)std::floor(minY), 0), y1 = std::min((int)std::ceil(maxY), bufferHeight - 1);
+    for (int ty = y0 / TILE; ty <= y1 / TILE; ty++) {
+        for (int tx = x0 / TILE; tx <= x1 / TILE; tx++) {
+            // the whole tile is nearer than the box
+            if (tileMax[(size_t)ty * tilesX + tx] <= minZ)
+                continue;
+            int py0 = std::max(y0, ty * TILE), py1 = std::min(y1, ty * TILE + TILE - 1);
+            int px0 = std::max(x0, tx * TILE), px1 = std::min(x1, tx * TILE + TILE - 1);
+            for (int y = py0; y <= py1; y++) {
+                const float* row = &depthBuffer[(size_t)y * bufferWidth];
+                for (int x = px0; x <= px1; x++)
+                    if (row[x] > minZ)
+                        return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,508 @@
+#include "include/portals.hpp"
+#include "include/log.hpp"
+#include "include/profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+std::string jklSidecarPath(const std::string& path, const char* extension) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + extension;
+    return path.substr(0, dot) + extension;
+}
+
+bool JklCellGraph::load(const char* path) {
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    cells.clear();
+    portals.clear();
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string keyword;
+        if (!(in >> keyword) || keyword[0] == '#')
+            continue;
+        if (keyword == "cell") {
+            JklCell cell;
+            glm::vec3 a, b;
+            // portals refer to cells by index, so a cell can't be skipped like a bad portal
+            if (!(in >> a.x >> a.y >> a.z >> b.x >> b.y >> b.z)) {
+                JKL_ERROR(ELOG_ASSET, "ERROR::PORTALS::BAD_CELL: %s: %s", path, line.c_str());
+                cells.clear();
+                portals.clear();
+                return false;
+            }
+            cell.box.expand(a);
+            cell.box.expand(b);
+            cells.push_back(cell);
+        }
+        else if (keyword == "portal") {
+            JklPortal portal;
+            int count = 0;
+            in >> portal.cells[0] >> portal.cells[1] >> count;
+            if (in && count >= 3 && count <= MAX_PORTAL_POINTS) {
+                for (int i = 0; i < count; i++) {
+                    glm::vec3 p;
+                    if (!(in >> p.x >> p.y >> p.z))
+                        break;
+                    portal.points.push_back(p);
+                }
+            }
+            if (!in || count < 3 || count > MAX_PORTAL_POINTS) {
+                JKL_ERROR(ELOG_ASSET, "ERROR::PORTALS::BAD_PORTAL: %s: %s", path, line.c_str());
+                continue;
+            }
+            portals.push_back(portal);
+        }
+    }
+
+    for (const JklPortal& portal : portals) {
+        if (portal.cells[0] < 0 || portal.cells[1] < 0 || portal.cells[0] >= (int)cells.size() || portal.cells[1] >= (int)cells.size()) {
+            JKL_ERROR(ELOG_ASSET, "ERROR::PORTALS::BAD_CELL_INDEX: %s", path);
+            cells.clear();
+            portals.clear();
+            return false;
+        }
+    }
+    link();
+    return !cells.empty();
+}
+
+bool JklCellGraph::save(const char* path) const {
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    file << "# jackal portal file, " << cells.size() << " cells, " << portals.size() << " portals\n";
+    for (const JklCell& cell : cells)
+        file << "cell " << cell.box.min.x << " " << cell.box.min.y << " " << cell.box.min.z << " "
+             << cell.box.max.x << " " << cell.box.max.y << " " << cell.box.max.z << "\n";
+    for (const JklPortal& portal : portals) {
+        file << "portal " << portal.cells[0] << " " << portal.cells[1] << " " << portal.points.size();
+        for (const glm::vec3& p : portal.points)
+            file << " " << p.x << " " << p.y << " " << p.z;
+        file << "\n";
+    }
+    return (bool)file;
+}
+
+void JklCellGraph::link(void) {
+    for (JklCell& cell : cells)
+        cell.portals.clear();
+    for (size_t i = 0; i < portals.size(); i++) {
+        cells[portals[i].cells[0]].portals.push_back((int)i);
+        cells[portals[i].cells[1]].portals.push_back((int)i);
+    }
+}
+
+// Moller-Trumbore, only whether the segment origin + t * direction, t in [0, 1], hits
+static bool segmentHitsTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3* tri) {
+    glm::vec3 e1 = tri[1] - tri[0], e2 = tri[2] - tri[0];
+    glm::vec3 p = glm::cross(direction, e2);
+    float det = glm::dot(e1, p);
+    if (std::fabs(det) < 1e-12f)
+        return false;
+    float inverse = 1.0f / det;
+    glm::vec3 s = origin - tri[0];
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    float t = glm::dot(e2, q) * inverse;
+    return t >= 0.0f && t <= 1.0f;
+}
+
+void JklCellGraph::generate(const glm::vec3* points, size_t count, float cellSize) {
+    cells.clear();
+    portals.clear();
+    JklAabb bounds;
+    for (size_t i = 0; i < count; i++)
+        bounds.expand(points[i]);
+    if (!bounds.valid() || cellSize <= 0.0f)
+        return;
+
+    int dims[3];
+    for (int axis = 0; axis < 3; axis++)
+        dims[axis] = std::max((int)std::ceil((bounds.max[axis] - bounds.min[axis]) / cellSize), 1);
+    auto cellIndex = [&](int x, int y, int z) { return (z * dims[1] + y) * dims[0] + x; };
+
+    cells.resize((size_t)dims[0] * dims[1] * dims[2]);
+    for (int z = 0; z < dims[2]; z++)
+        for (int y = 0; y < dims[1]; y++)
+            for (int x = 0; x < dims[0]; x++) {
+                glm::vec3 lo = bounds.min + glm::vec3(x, y, z) * cellSize;
+                JklAabb& box = cells[cellIndex(x, y, z)].box;
+                box.expand(lo);
+                box.expand(lo + glm::vec3(cellSize));
+            }
+
+    size_t triangles = count / 3;
+    std::vector<JklAabb> triangleBoxes(triangles);
+    for (size_t t = 0; t < triangles; t++)
+        for (int v = 0; v < 3; v++)
+            triangleBoxes[t].expand(points[t * 3 + v]);
+
+    // a short segment crosses the shared face at every sample, geometry it hits closes that sample
+    const float reach = cellSize * 0.05f;
+    // cell index range [first, last] along axis whose cells span [lo, hi], one wider on each
+    // side so rounding never loses a cell, the exact test below still decides
+    auto cellRange = [&](int axis, float lo, float hi, int& first, int& last) {
+        first = (int)std::fmax(std::floor((lo - bounds.min[axis]) / cellSize) - 1.0f, 0.0f);
+        last = (int)std::fmin(std::floor((hi - bounds.min[axis]) / cellSize) + 1.0f, (float)(dims[axis] - 1));
+    };
+    // triangles binned by the faces they may touch, keyed by the cell on the low side of the face
+    std::vector<std::vector<size_t>> faceTriangles(cells.size());
+    std::vector<size_t> candidates;
+    for (int axis = 0; axis < 3; axis++) {
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for (std::vector<size_t>& bin : faceTriangles)
+            bin.clear();
+        for (size_t t = 0; t < triangles; t++) {
+            const JklAabb& tb = triangleBoxes[t];
+            int first[3], last[3];
+            // the face after cell c along axis lies at its box max
+            cellRange(axis, tb.min[axis] - reach - cellSize, tb.max[axis] + reach - cellSize, first[axis], last[axis]);
+            cellRange(u, tb.min[u], tb.max[u], first[u], last[u]);
+            cellRange(v, tb.min[v], tb.max[v], first[v], last[v]);
+            last[axis] = std::min(last[axis], dims[axis] - 2);
+            int c[3];
+            for (c[2] = first[2]; c[2] <= last[2]; c[2]++)
+                for (c[1] = first[1]; c[1] <= last[1]; c[1]++)
+                    for (c[0] = first[0]; c[0] <= last[0]; c[0]++)
+                        faceTriangles[cellIndex(c[0], c[1], c[2])].push_back(t);
+        }
+
+        for (int z = 0; z < dims[2]; z++)
+            for (int y = 0; y < dims[1]; y++)
+                for (int x = 0; x < dims[0]; x++) {
+                    int c[3] = {x, y, z};
+                    if (c[axis] + 1 >= dims[axis])
+                        continue;
+                    int a = cellIndex(x, y, z);
+                    c[axis]++;
+                    int b = cellIndex(c[0], c[1], c[2]);
+
+                    const JklAabb& box = cells[a].box;
+                    float plane = box.max[axis];
+                    candidates.clear();
+                    for (size_t t : faceTriangles[a]) {
+                        const JklAabb& tb = triangleBoxes[t];
+                        if (tb.max[axis] < plane - reach || tb.min[axis] > plane + reach)
+                            continue;
+                        if (tb.max[u] < box.min[u] || tb.min[u] > box.max[u] || tb.max[v] < box.min[v] || tb.min[v] > box.max[v])
+                            continue;
+                        candidates.push_back(t);
+                    }
+
+                    float step = cellSize / FACE_SAMPLES;
+                    JklAabb open;
+                    for (int i = 0; i < FACE_SAMPLES; i++)
+                        for (int j = 0; j < FACE_SAMPLES; j++) {
+                            glm::vec3 origin;
+                            origin[axis] = plane - reach;
+                            origin[u] = box.min[u] + (i + 0.5f) * step;
+                            origin[v] = box.min[v] + (j + 0.5f) * step;
+                            glm::vec3 direction(0.0f);
+                            direction[axis] = reach * 2.0f;
+                            bool blocked = false;
+                            for (size_t t : candidates)
+                                if ((blocked = segmentHitsTriangle(origin, direction, &points[t * 3])))
+                                    break;
+                            if (blocked)
+                                continue;
+                            // an opening may reach up to the next sample, grow by one step
+                            // so the portal never ends up smaller than it
+                            glm::vec3 lo = origin, hi = origin;
+                            lo[axis] = hi[axis] = plane;
+                            lo[u] = std::max(lo[u] - step * 1.5f, box.min[u]);
+                            lo[v] = std::max(lo[v] - step * 1.5f, box.min[v]);
+                            hi[u] = std::min(hi[u] + step * 1.5f, box.max[u]);
+                            hi[v] = std::min(hi[v] + step * 1.5f, box.max[v]);
+                            open.expand(lo);
+                            open.expand(hi);
+                        }
+                    if (!open.valid())
+                        continue;
+
+                    JklPortal portal;
+                    portal.cells[0] = a;
+                    portal.cells[1] = b;
+                    glm::vec3 corner = open.min;
+                    portal.points.push_back(corner);
+                    corner[u] = open.max[u];
+                    portal.points.push_back(corner);
+                    corner[v] = open.max[v];
+                    portal.points.push_back(corner);
+                    corner[u] = open.min[u];
+                    portal.points.push_back(corner);
+                    portals.push_back(portal);
+                }
+    }
+    link();
+}
+
+static float distanceToBox(const JklAabb& box, const glm::vec3& p) {
+    glm::vec3 nearest = glm::clamp(p, box.min, box.max);
+    return glm::length(nearest - p);
+}
+
+std::vector<int> JklCellGraph::assignTriangles(const glm::vec3* points, size_t count) {
+    size_t triangles = count / 3;
+    std::vector<int> owner(triangles);
+    for (size_t t = 0; t < triangles; t++) {
+        glm::vec3 centroid = (points[t * 3] + points[t * 3 + 1] + points[t * 3 + 2]) * (1.0f / 3.0f);
+        int cell = findCell(centroid);
+        if (cell < 0) {
+            // authored cells need not cover every triangle, give strays to the nearest cell
+            float best = INFINITY;
+            for (size_t c = 0; c < cells.size(); c++) {
+                float d = distanceToBox(cells[c].box, centroid);
+                if (d < best) {
+                    best = d;
+                    cell = (int)c;
+                }
+            }
+        }
+        owner[t] = cell;
+    }
+
+    std::vector<int> order(triangles);
+    for (size_t t = 0; t < triangles; t++)
+        order[t] = (int)t;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return owner[a] < owner[b]; });
+
+    for (JklCell& cell : cells) {
+        cell.first = cell.count = 0;
+        cell.drawBounds = JklAabb();
+        cell.overlaps.clear();
+    }
+    for (size_t i = 0; i < triangles; i++) {
+        JklCell& cell = cells[owner[order[i]]];
+        if (cell.count == 0)
+            cell.first = (int)i * 3;
+        cell.count += 3;
+        for (int v = 0; v < 3; v++)
+            cell.drawBounds.expand(points[order[i] * 3 + v]);
+    }
+
+    for (size_t a = 0; a < cells.size(); a++) {
+        const JklAabb& box = cells[a].box;
+        for (size_t b = 0; b < cells.size(); b++) {
+            const JklAabb& reach = cells[b].drawBounds;
+            if (a == b || !reach.valid())
+                continue;
+            if (reach.min.x < box.max.x && reach.max.x > box.min.x && reach.min.y < box.max.y && reach.max.y > box.min.y
+                && reach.min.z < box.max.z && reach.max.z > box.min.z)
+                cells[a].overlaps.push_back((int)b);
+        }
+    }
+    return order;
+}
+
+int JklCellGraph::findCell(const glm::vec3& p) const {
+    for (size_t i = 0; i < cells.size(); i++) {
+        const JklAabb& box = cells[i].box;
+        if (p.x >= box.min.x && p.x <= box.max.x && p.y >= box.min.y && p.y <= box.max.y && p.z >= box.min.z && p.z <= box.max.z)
+            return (int)i;
+    }
+    return -1;
+}
+
+static bool boxInside(const JklAabb& box, const JklFrameVector<glm::vec4>& planes) {
+    if (!box.valid())
+        return false;
+    glm::vec3 c = box.center(), e = box.extents();
+    for (const glm::vec4& plane : planes) {
+        float dist = plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w;
+        float radius = std::fabs(plane.x) * e.x + std::fabs(plane.y) * e.y + std::fabs(plane.z) * e.z;
+        if (dist + radius < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// Screen regions are NDC rectangles (x0, y0, x1, y1), empty unless x0 < x1 and y0 < y1
+static const glm::vec4 NO_REGION(INFINITY, INFINITY, -INFINITY, -INFINITY);
+
+static bool regionEmpty(const glm::vec4& r) {
+    return !(r.x < r.z && r.y < r.w);
+}
+
+static glm::vec4 regionIntersect(const glm::vec4& a, const glm::vec4& b) {
+    return glm::vec4(std::max(a.x, b.x), std::max(a.y, b.y), std::min(a.z, b.z), std::min(a.w, b.w));
+}
+
+// a holds all of b
+static bool regionContains(const glm::vec4& a, const glm::vec4& b) {
+    return a.x <= b.x && a.y <= b.y && a.z >= b.z && a.w >= b.w;
+}
+
+static glm::vec4 regionUnion(const glm::vec4& a, const glm::vec4& b) {
+    return glm::vec4(std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.z, b.z), std::max(a.w, b.w));
+}
+
+// clip w below this is treated as behind the eye
+static const float PORTAL_MIN_W = 1e-5f;
+
+// NDC bounds of the part of a portal in front of the eye and nearer than the far plane. The portal
+// is clipped at the eye rather than at the near plane: rays through the part of a portal nearer
+// than the near plane still see what lies behind it
+static glm::vec4 portalRegion(const std::vector<glm::vec3>& points, const glm::mat4& viewProjection) {
+    JklFrameVector<glm::vec4> polygon, clipped;
+    polygon.reserve(points.size() + 2);
+    clipped.reserve(points.size() + 2);
+    for (const glm::vec3& point : points)
+        polygon.push_back(viewProjection * glm::vec4(point, 1.0f));
+    for (int plane = 0; plane < 2 && polygon.size() >= 3; plane++) {
+        clipped.clear();
+        for (size_t i = 0; i < polygon.size(); i++) {
+            const glm::vec4& a = polygon[i];
+            const glm::vec4& b = polygon[(i + 1) % polygon.size()];
+            // w >= PORTAL_MIN_W, then z <= w
+            float da = plane == 0 ? a.w - PORTAL_MIN_W : a.w - a.z;
+            float db = plane == 0 ? b.w - PORTAL_MIN_W : b.w - b.z;
+            if (da >= 0.0f)
+                clipped.push_back(a);
+            if ((da >= 0.0f) != (db >= 0.0f))
+                clipped.push_back(a + (b - a) * (da / (da - db)));
+        }
+        polygon.swap(clipped);
+    }
+    glm::vec4 region = NO_REGION;
+    if (polygon.size() < 3)
+        return region;
+    for (const glm::vec4& clip : polygon) {
+        float x = clip.x / clip.w, y = clip.y / clip.w;
+        region = regionUnion(region, glm::vec4(x, y, x, y));
+    }
+    return region;
+}
+
+// the eye is in the opening, the portal is seen edge on and can't narrow anything
+static bool standingInPortal(const JklPortal& portal, const glm::vec3& eye, float reach) {
+    const std::vector<glm::vec3>& points = portal.points;
+    glm::vec3 normal = glm::cross(points[1] - points[0], points[2] - points[0]);
+    float length = glm::length(normal);
+    if (length < 1e-12f)
+        return false;
+    if (std::fabs(glm::dot(normal * (1.0f / length), eye - points[0])) > reach)
+        return false;
+    JklAabb box;
+    for (const glm::vec3& point : points)
+        box.expand(point);
+    glm::vec3 lo = box.min - glm::vec3(reach), hi = box.max + glm::vec3(reach);
+    return eye.x >= lo.x && eye.x <= hi.x && eye.y >= lo.y && eye.y <= hi.y && eye.z >= lo.z && eye.z <= hi.z;
+}
+
+// near and far, then the four sides of region, in the space viewProjection maps from
+static void regionPlanes(const glm::mat4& m, const JklFrustum& frustum, const glm::vec4& region, JklFrameVector<glm::vec4>& planes) {
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    planes.clear();
+    planes.push_back(frustum.plane(4));
+    planes.push_back(frustum.plane(5));
+    planes.push_back(row0 - row3 * region.x);   // x >= x0 * w
+    planes.push_back(row3 * region.z - row0);   // x <= x1 * w
+    planes.push_back(row1 - row3 * region.y);
+    planes.push_back(row3 * region.w - row1);
+}
+
+void JklCellGraph::visibleCells(const glm::vec3& eye, const glm::mat4& viewProjection, JklFrameVector<int>& out) const {
+    JKL_PROFILE_SCOPE("portals");
+    // out grows before the scope opens, so rolling the arena back can't take it along
+    out.reserve(out.size() + cells.size());
+    JklArenaScope scope;
+    JklFrustum frustum(viewProjection);
+
+    int start = findCell(eye);
+    if (start < 0) {
+        // outside the level, nothing to walk through, fall back to the frustum
+        for (size_t i = 0; i < cells.size(); i++)
+            if (frustum.testAabb(cells[i].drawBounds))
+                out.push_back((int)i);
+        return;
+    }
+
+    // Every cell keeps the union of the screen regions it was reached through and is walked again
+    // only when that grows, so each portal is crossed a handful of times however many paths lead
+    // to it. Following every path separately is exponential on open grids
+    const size_t count = cells.size();
+    JklFrameVector<glm::vec4> regions(count, NO_REGION);
+    JklFrameVector<char> queued(count, 0);
+    // a cell is queued at most once at a time, so the queue is a ring of count entries
+    JklFrameVector<int> queue(count);
+    size_t head = 0, queuedCount = 1;
+    regions[start] = glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f);
+    queue[0] = start;
+    queued[start] = 1;
+
+    glm::vec4 nearPlane = frustum.plane(4);
+    float nearDistance = std::fabs(glm::dot(glm::vec3(nearPlane), eye) + nearPlane.w);
+    size_t budget = count * MAX_WIDENINGS;
+    bool exhausted = false;
+    while (queuedCount > 0) {
+        if (budget-- == 0) {
+            exhausted = true;
+            break;
+        }
+        int index = queue[head];
+        head = (head + 1) % count;
+        queuedCount--;
+        queued[index] = 0;
+        glm::vec4 region = regions[index];
+
+        for (int p : cells[index].portals) {
+            const JklPortal& portal = portals[p];
+            int next = portal.cells[0] == index ? portal.cells[1] : portal.cells[0];
+            JklArenaScope portalScope;
+            glm::vec4 through = standingInPortal(portal, eye, nearDistance) ? region
+                : regionIntersect(region, portalRegion(portal.points, viewProjection));
+            if (regionEmpty(through))
+                continue;
+            if (regionContains(regions[next], through))
+                continue;
+            regions[next] = regionUnion(regions[next], through);
+            if (!queued[next]) {
+                queue[(head + queuedCount) % count] = next;
+                queuedCount++;
+                queued[next] = 1;
+            }
+        }
+    }
+
+    JklFrameVector<char> visible(count, 0);
+    JklFrameVector<glm::vec4> planes;
+    planes.reserve(6);
+    for (size_t i = 0; i < count; i++) {
+        if (regionEmpty(regions[i]))
+            continue;
+        visible[i] = 1;
+        // triangles of neighbouring cells reaching in are seen through this cell's region too
+        regionPlanes(viewProjection, frustum, regions[i], planes);
+        for (int other : cells[i].overlaps)
+            if (!visible[other] && boxInside(cells[other].drawBounds, planes))
+                visible[other] = 1;
+    }
+    if (exhausted) {
+        // never lose cells to the budget, whatever the walk didn't get to is left to the frustum
+        static std::atomic<bool> warned(false);
+        if (!warned.exchange(true))
+            JKL_WARN(ELOG_RENDER, "portal walk over budget in a %zu cell graph, falling back to the frustum", count);
+        for (size_t i = 0; i < count; i++)
+            if (!visible[i] && frustum.testAabb(cells[i].drawBounds))
+                visible[i] = 1;
+    }
+    for (size_t i = 0; i < count; i++)
+        if (visible[i])
+            out.push_back((int)i);
+}
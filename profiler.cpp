@@ -0,0 +1,382 @@
+#include "include/profiler.hpp"
+#include "include/log.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <utility>
+#ifdef _WIN32
+#include "include/mingw.mutex.h"
+#endif
+
+#ifdef __linux__
+#include <mutex>
+#endif
+
+int jklProfileWindow = 512;
+int jklProfileGpuLatency = 4;
+
+namespace {
+
+struct Event {
+    const char* name;
+    int64_t start;
+    int64_t duration;
+};
+
+// one per thread that ever opened a scope, kept for the life of the process
+struct ThreadBuffer {
+    int id;
+    std::string name;
+    std::mutex mutex;
+    std::vector<Event> events;
+    // swapped with events every frame, so both keep their capacity and scopes never regrow them
+    std::vector<Event> spare;
+};
+
+struct CaptureEvent {
+    const char* name;
+    int64_t start;
+    int64_t duration;
+    int thread;
+    double value;
+};
+
+struct Window {
+    std::vector<double> samples;
+    size_t next = 0;
+};
+
+struct GpuQuery {
+    const char* name;
+    GLuint id;
+    int64_t cpuStart;
+};
+
+struct GpuFrame {
+    std::vector<GpuQuery> queries;
+    size_t used = 0;
+};
+
+}
+
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+static std::mutex registryMutex;
+static std::vector<ThreadBuffer*> threads;
+static thread_local ThreadBuffer* localBuffer = nullptr;
+
+// stats and the capture are only written by jklprofileEndFrame but read from any thread
+static std::mutex statsMutex;
+static std::map<std::pair<std::string, bool>, Window> windows;
+// transparent, so counters that already have a window are found without building a string
+static std::map<std::string, Window, std::less<>> counters;
+static bool capturing = false;
+static std::vector<CaptureEvent> capture;
+
+// GL thread only
+static std::vector<GpuFrame> gpuFrames;
+static size_t gpuSlot = 0;
+static bool gpuActive = false;
+// jklprofileEndFrame's per frame lists, kept so their capacity is reused
+static std::vector<CaptureEvent> frameEvents;
+static std::vector<CaptureEvent> frameGpuEvents;
+
+// the GPU track in captures, CPU threads count up from 1
+static const int gpuThread = 0;
+// counter samples in captures, they have no thread
+static const int counterThread = -1;
+
+static int64_t now(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+static ThreadBuffer* threadBuffer(void) {
+    if (!localBuffer) {
+        ThreadBuffer* buffer = new ThreadBuffer();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threads.push_back(buffer);
+        buffer->id = (int)threads.size();
+        buffer->name = "thread " + std::to_string(buffer->id);
+        localBuffer = buffer;
+    }
+    return localBuffer;
+}
+
+JklProfileScope::JklProfileScope(const char* name) : name(name), start(now()) {}
+
+JklProfileScope::~JklProfileScope(void) {
+    int64_t end = now();
+    ThreadBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->events.push_back({name, start, end - start});
+}
+
+JklGpuScope::JklGpuScope(const char* name) : query(-1) {
+    if (gpuActive)
+        return;
+    if (gpuFrames.empty())
+        gpuFrames.resize(std::max(jklProfileGpuLatency, 2));
+    GpuFrame& frame = gpuFrames[gpuSlot];
+    if (frame.used == frame.queries.size()) {
+        GpuQuery fresh = {nullptr, 0, 0};
+        glGenQueries(1, &fresh.id);
+        frame.queries.push_back(fresh);
+    }
+    GpuQuery& q = frame.queries[frame.used];
+    q.name = name;
+    q.cpuStart = now();
+    glBeginQuery(GL_TIME_ELAPSED, q.id);
+    query = (int)frame.used++;
+    gpuActive = true;
+}
+
+JklGpuScope::~JklGpuScope(void) {
+    if (query < 0)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuActive = false;
+}
+
+static void addSample(Window& window, double ms) {
+    size_t size = (size_t)std::max(jklProfileWindow, 1);
+    if (window.samples.size() < size)
+        window.samples.push_back(ms);
+    else
+        window.samples[window.next % size] = ms;
+    window.next++;
+}
+
+void jklprofileThreadName(const char* name) {
+    ThreadBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->name = name;
+}
+
+void jklprofileEndFrame(void) {
+    // the oldest slot is read back and reused for the frame about to start
+    std::vector<CaptureEvent>& gpuEvents = frameGpuEvents;
+    gpuEvents.clear();
+    if (!gpuFrames.empty()) {
+        gpuSlot = (gpuSlot + 1) % gpuFrames.size();
+        GpuFrame& frame = gpuFrames[gpuSlot];
+        for (size_t i = 0; i < frame.used; i++) {
+            GLint available = 0;
+            glGetQueryObjectiv(frame.queries[i].id, GL_QUERY_RESULT_AVAILABLE, &available);
+            // still not done after a full ring of frames, losing the sample beats waiting for it
+            if (!available)
+                continue;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(frame.queries[i].id, GL_QUERY_RESULT, &elapsed);
+            // TIME_ELAPSED has no start time, the GPU track places it where the CPU issued it
+            gpuEvents.push_back({frame.queries[i].name, frame.queries[i].cpuStart, (int64_t)elapsed, gpuThread, 0.0});
+        }
+        frame.used = 0;
+    }
+
+    std::vector<CaptureEvent>& events = frameEvents;
+    events.clear();
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (ThreadBuffer* buffer : threads) {
+            {
+                std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+                buffer->spare.swap(buffer->events);
+            }
+            // only this function touches spare, the thread is already filling the other buffer
+            for (const Event& event : buffer->spare)
+                events.push_back({event.name, event.start, event.duration, buffer->id, 0.0});
+            buffer->spare.clear();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    for (const CaptureEvent& event : events)
+        addSample(windows[std::make_pair(std::string(event.name), false)], event.duration / 1e6);
+    for (const CaptureEvent& event : gpuEvents)
+        addSample(windows[std::make_pair(std::string(event.name), true)], event.duration / 1e6);
+    if (capturing) {
+        capture.insert(capture.end(), events.begin(), events.end());
+        capture.insert(capture.end(), gpuEvents.begin(), gpuEvents.end());
+    }
+}
+
+void jklprofileCounter(const char* name, double value) {
+    int64_t time = now();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    auto it = counters.find(name);
+    if (it == counters.end())
+        it = counters.emplace(name, Window()).first;
+    addSample(it->second, value);
+    if (capturing)
+        capture.push_back({name, time, 0, counterThread, value});
+}
+
+void jklprofileShutdown(void) {
+    if (gpuActive)
+        glEndQuery(GL_TIME_ELAPSED);
+    gpuActive = false;
+    for (GpuFrame& frame : gpuFrames)
+        for (GpuQuery& q : frame.queries)
+            glDeleteQueries(1, &q.id);
+    gpuFrames.clear();
+    gpuSlot = 0;
+}
+
+void jklprofileBeginCapture(void) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    capture.clear();
+    capturing = true;
+}
+
+bool jklprofileCapturing(void) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return capturing;
+}
+
+static void writeString(FILE* out, const std::string& text) {
+    fputc('"', out);
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            fputc('\\', out);
+        if ((unsigned char)c >= 0x20)
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+bool jklprofileEndCapture(const char* path) {
+    std::vector<CaptureEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        capturing = false;
+        events.swap(capture);
+    }
+    std::vector<std::pair<int, std::string>> names;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (ThreadBuffer* buffer : threads)
+            names.push_back(std::make_pair(buffer->id, buffer->name));
+    }
+    names.push_back(std::make_pair(gpuThread, std::string("GPU")));
+
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        JKL_ERROR(ELOG_PROFILE, "ERROR::PROFILE::CAPTURE_NOT_WRITTEN: %s", path);
+        return false;
+    }
+    // Chrome trace event format, complete ("X") and counter ("C") events with times in microseconds
+    fprintf(out, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto& name : names) {
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", name.first);
+        writeString(out, name.second);
+        fprintf(out, "}}");
+        first = false;
+    }
+    for (const CaptureEvent& event : events) {
+        fprintf(out, ",\n{\"name\":");
+        writeString(out, event.name);
+        if (event.thread == counterThread) {
+            fprintf(out, ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"value\":%.6g}}", event.start / 1e3, event.value);
+            continue;
+        }
+        fprintf(out, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+            event.thread == gpuThread ? "gpu" : "cpu", event.start / 1e3, event.duration / 1e3, event.thread);
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    if (ok)
+        JKL_INFO(ELOG_PROFILE, "capture of %zu events written to %s", events.size(), path);
+    else
+        JKL_ERROR(ELOG_PROFILE, "ERROR::PROFILE::CAPTURE_NOT_WRITTEN: %s", path);
+    return ok;
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t index = (size_t)std::ceil(p * sorted.size());
+    return sorted[std::min(std::max(index, (size_t)1), sorted.size()) - 1];
+}
+
+static JklProfileStats summarize(const std::string& name, bool gpu, bool counter, const Window& window) {
+    JklProfileStats stats;
+    stats.name = name;
+    stats.gpu = gpu;
+    stats.counter = counter;
+    stats.samples = (int)window.samples.size();
+    if (window.samples.empty())
+        return stats;
+    std::vector<double> sorted(window.samples);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (double sample : sorted)
+        sum += sample;
+    stats.mean = sum / sorted.size();
+    stats.p95 = percentile(sorted, 0.95);
+    stats.p99 = percentile(sorted, 0.99);
+    stats.max = sorted.back();
+    return stats;
+}
+
+bool jklprofileStats(const char* name, JklProfileStats& out, bool gpu) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    auto it = windows.find(std::make_pair(std::string(name), gpu));
+    if (it == windows.end() || it->second.samples.empty())
+        return false;
+    out = summarize(it->first.first, gpu, false, it->second);
+    return true;
+}
+
+std::vector<JklProfileStats> jklprofileAllStats(void) {
+    std::vector<JklProfileStats> all;
+    std::lock_guard<std::mutex> lock(statsMutex);
+    for (const auto& window : windows)
+        all.push_back(summarize(window.first.first, window.first.second, false, window.second));
+    for (const auto& counter : counters)
+        all.push_back(summarize(counter.first, false, true, counter.second));
+    return all;
+}
+
+bool jklprofileSamples(const char* name, std::vector<double>& out, bool gpu) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    auto it = windows.find(std::make_pair(std::string(name), gpu));
+    if (it == windows.end() || it->second.samples.empty())
+        return false;
+    const Window& window = it->second;
+    size_t size = window.samples.size();
+    // once the ring has wrapped the oldest sample is the one next would overwrite
+    size_t oldest = window.next > size ? window.next % size : 0;
+    out.clear();
+    for (size_t i = 0; i < size; i++)
+        out.push_back(window.samples[(oldest + i) % size]);
+    return true;
+}
+
+void jklprofileResetStats(void) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    windows.clear();
+    counters.clear();
+}
+
+void jklprofileReport(void) {
+    std::vector<JklProfileStats> all = jklprofileAllStats();
+    if (all.empty())
+        return;
+    std::sort(all.begin(), all.end(), [](const JklProfileStats& a, const JklProfileStats& b) {
+        return a.counter != b.counter ? b.counter : a.mean > b.mean;
+    });
+    for (const JklProfileStats& stats : all) {
+        if (stats.counter)
+            JKL_INFO(ELOG_PROFILE, "counter %-18s mean %10.1f  p95 %10.1f  p99 %10.1f  max %10.1f  (%d samples)",
+                stats.name.c_str(), stats.mean, stats.p95, stats.p99, stats.max, stats.samples);
+        else
+            JKL_INFO(ELOG_PROFILE, "%s %-20s mean %7.3f ms  p95 %7.3f  p99 %7.3f  max %7.3f  (%d samples)",
+                stats.gpu ? "gpu" : "cpu", stats.name.c_str(), stats.mean, stats.p95, stats.p99, stats.max, stats.samples);
+    }
+}
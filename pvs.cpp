@@ -0,0 +1,176 @@
+#include "include/pvs.hpp"
+#include "include/levelfile.hpp"
+#include "include/log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+void JklPvs::setGrid(const JklAabb& bounds, float size) {
+    origin = bounds.min;
+    cellSize = size;
+    for (int axis = 0; axis < 3; axis++)
+        dims[axis] = std::max((int)std::ceil((bounds.max[axis] - bounds.min[axis]) / size), 1);
+    offsets.clear();
+    data.clear();
+    cachedCell = -1;
+}
+
+JklAabb JklPvs::cellBox(int cell) const {
+    int x = cell % dims[0];
+    int y = (cell / dims[0]) % dims[1];
+    int z = cell / (dims[0] * dims[1]);
+    glm::vec3 lo = origin + glm::vec3(x, y, z) * cellSize;
+    JklAabb box;
+    box.expand(lo);
+    box.expand(lo + glm::vec3(cellSize));
+    return box;
+}
+
+int JklPvs::cellAt(const glm::vec3& point) const {
+    if (cellSize <= 0.0f)
+        return -1;
+    int c[3];
+    for (int axis = 0; axis < 3; axis++) {
+        float f = (point[axis] - origin[axis]) / cellSize;
+        if (!(f >= 0.0f) || f > (float)dims[axis])
+            return -1;
+        // the far faces belong to the last cell
+        c[axis] = std::min((int)f, dims[axis] - 1);
+    }
+    return (c[2] * dims[1] + c[1]) * dims[0] + c[0];
+}
+
+void JklPvs::compress(const std::vector<uint8_t>& bits) {
+    const size_t bytes = rowBytes();
+    const int count = cellCount();
+    offsets.assign(count, 0);
+    data.clear();
+    cachedCell = -1;
+    // neighbouring cells, and every cell outside the level, tend to share rows, those are stored once
+    std::unordered_map<std::string, uint32_t> stored;
+    std::string packed;
+    for (int cell = 0; cell < count; cell++) {
+        const uint8_t* row = &bits[(size_t)cell * bytes];
+        packed.clear();
+        for (size_t i = 0; i < bytes; i++) {
+            if (row[i] != 0) {
+                packed.push_back((char)row[i]);
+                continue;
+            }
+            size_t run = 1;
+            while (i + run < bytes && row[i + run] == 0 && run < 255)
+                run++;
+            packed.push_back(0);
+            packed.push_back((char)run);
+            i += run - 1;
+        }
+        auto found = stored.find(packed);
+        if (found != stored.end()) {
+            offsets[cell] = found->second;
+            continue;
+        }
+        offsets[cell] = (uint32_t)data.size();
+        stored.emplace(packed, offsets[cell]);
+        data.insert(data.end(), packed.begin(), packed.end());
+    }
+}
+
+bool JklPvs::load(const char* path, const char* levelPath) {
+    std::ifstream infile(path, std::ios::binary);
+    if (!infile)
+        return false;
+    char magic[4];
+    int32_t grid[3];
+    float floats[4];
+    uint64_t level[2];
+    uint32_t size;
+    infile.read(magic, 4);
+    if (infile && memcmp(magic, "JKV1", 4) == 0) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::JKV::OLD_VERSION: %s doesn't say which level it was built from, rebuild it with jkpvs", path);
+        return false;
+    }
+    infile.read(reinterpret_cast<char*>(grid), sizeof(grid));
+    infile.read(reinterpret_cast<char*>(floats), sizeof(floats));
+    infile.read(reinterpret_cast<char*>(level), sizeof(level));
+    infile.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!infile || memcmp(magic, "JKV2", 4) != 0 || grid[0] <= 0 || grid[1] <= 0 || grid[2] <= 0
+        || (int64_t)grid[0] * grid[1] * grid[2] > (1 << 24) || !(floats[0] > 0.0f)) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::JKV::INVALID_FILE: %s", path);
+        return false;
+    }
+    uint64_t currentSize = 0, currentHash = 0;
+    if (!jklLevelFingerprint(levelPath, currentSize, currentHash) || currentSize != level[0] || currentHash != level[1]) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::JKV::STALE_FILE: %s wasn't built from the current %s, rebuild it with jkpvs", path, levelPath);
+        return false;
+    }
+    levelSize = level[0];
+    levelHash = level[1];
+    dims[0] = grid[0];
+    dims[1] = grid[1];
+    dims[2] = grid[2];
+    cellSize = floats[0];
+    origin = glm::vec3(floats[1], floats[2], floats[3]);
+    offsets.resize(cellCount());
+    data.resize(size);
+    infile.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    infile.read(reinterpret_cast<char*>(data.data()), size);
+    cachedCell = -1;
+    bool valid = (bool)infile;
+    for (size_t i = 0; valid && i < offsets.size(); i++)
+        valid = offsets[i] <= size;
+    if (!valid) {
+        JKL_ERROR(ELOG_ASSET, "ERROR::JKV::TRUNCATED_FILE: %s", path);
+        offsets.clear();
+        data.clear();
+        return false;
+    }
+    return true;
+}
+
+bool JklPvs::save(const char* path) const {
+    std::ofstream outfile(path, std::ios::binary);
+    int32_t grid[3] = {dims[0], dims[1], dims[2]};
+    float floats[4] = {cellSize, origin.x, origin.y, origin.z};
+    uint64_t level[2] = {levelSize, levelHash};
+    uint32_t size = (uint32_t)data.size();
+    outfile.write("JKV2", 4);
+    outfile.write(reinterpret_cast<const char*>(grid), sizeof(grid));
+    outfile.write(reinterpret_cast<const char*>(floats), sizeof(floats));
+    outfile.write(reinterpret_cast<const char*>(level), sizeof(level));
+    outfile.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    outfile.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    outfile.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return (bool)outfile;
+}
+
+const std::vector<int>& JklPvs::visibleCells(int cell) const {
+    if (cell == cachedCell)
+        return cached;
+    cached.clear();
+    cachedCell = cell;
+    if (cell < 0 || cell >= (int)offsets.size())
+        return cached;
+
+    // rows carry no length, the bit count says when to stop
+    const size_t bytes = rowBytes();
+    const int count = cellCount();
+    size_t in = offsets[cell], byte = 0;
+    while (byte < bytes && in < data.size()) {
+        uint8_t value = data[in++];
+        if (value == 0) {
+            byte += in < data.size() ? data[in++] : 1;
+            continue;
+        }
+        for (int bit = 0; bit < 8; bit++) {
+            int c = (int)byte * 8 + bit;
+            if ((value & (1 << bit)) && c < count)
+                cached.push_back(c);
+        }
+        byte++;
+    }
+    return cached;
+}
@@ -0,0 +1,55 @@
+#include "include/renderframe.hpp"
+
+#include <algorithm>
+
+JklFramePipeline::JklFramePipeline(int buffers) : count(std::min(std::max(buffers, 2), MAX_BUFFERS)) {}
+
+JklFrame& JklFramePipeline::beginFrame(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+    signal.wait(lock, [this] { return stopping || !ready[writeIndex]; });
+    frames[writeIndex].clear();
+    return frames[writeIndex];
+}
+
+void JklFramePipeline::submitFrame(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+    int submitted = writeIndex;
+    ready[submitted] = true;
+    writeIndex = (writeIndex + 1) % count;
+    signal.notify_all();
+    if (frames[submitted].serial)
+        signal.wait(lock, [this, submitted] { return stopping || !ready[submitted]; });
+}
+
+const JklFrame* JklFramePipeline::acquireFrame(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+    signal.wait(lock, [this] { return stopping || ready[readIndex]; });
+    if (stopping)
+        return nullptr;
+    return &frames[readIndex];
+}
+
+void JklFramePipeline::releaseFrame(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ready[readIndex] = false;
+    readIndex = (readIndex + 1) % count;
+    signal.notify_all();
+}
+
+void JklFramePipeline::finish(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+    signal.wait(lock, [this] {
+        if (stopping)
+            return true;
+        for (int i = 0; i < count; i++)
+            if (ready[i])
+                return false;
+        return true;
+    });
+}
+
+void JklFramePipeline::stop(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    signal.notify_all();
+}
@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+  
+in vec3 ourColor;
+in vec3 TexCoord;
+
+uniform sampler2DArray texture1;
+
+void main()
+{
+    FragColor = texture(texture1, TexCoord) * vec4(ourColor, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+layout (location = 2) in vec3 vnormals;
+layout (location = 3) in vec2 aTexCoord;
+layout (location = 4) in float aLayer;
+
+
+out vec3 ourColor;
+out vec3 TexCoord;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+
+void main()
+{
+	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	ourColor = aColor;
+	TexCoord = vec3(aTexCoord.x, aTexCoord.y, aLayer);
+}
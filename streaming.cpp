@@ -0,0 +1,434 @@
+#include "include/streaming.hpp"
+#include "include/jobs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#ifdef _WIN32
+#include "include/mingw.thread.h"
+#include "include/mingw.mutex.h"
+#include "include/mingw.condition_variable.h"
+#endif
+
+#ifdef __linux__
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+float jklStreamBudgetMs = 2.0f;
+size_t jklStreamBudgetBytes = 8 * 1024 * 1024;
+size_t jklGpuBudgetBytes = 256 * 1024 * 1024;
+
+static std::vector<std::thread> loaders;
+static std::deque<std::function<void(void)>> loadJobs;
+static std::mutex loadMutex;
+static std::condition_variable loadSignal;
+static std::atomic<int> loadsInFlight(0);
+static bool stopping = false;
+
+static JklMpmcQueue<JklUploadPacket*> uploads(1024);
+
+// upload thread state, only used when started with an upload context
+static GLFWwindow* uploadContext = nullptr;
+static std::thread uploader;
+static std::mutex uploadMutex;
+static std::condition_variable uploadSignal;
+static std::atomic<bool> uploaderStopping(false);
+static JklMpmcQueue<JklUploadPacket*> fenced(1024);
+static std::deque<JklUploadPacket*> awaitingFence;	// render thread only
+
+static std::vector<std::unique_ptr<JklAsset>> assets;
+static unsigned long long frameIndex = 1;
+
+
+static void loaderMain(void) {
+    for (;;) {
+        std::function<void(void)> job;
+        {
+            std::unique_lock<std::mutex> lock(loadMutex);
+            loadSignal.wait(lock, [] { return stopping || !loadJobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(loadJobs.front());
+            loadJobs.pop_front();
+        }
+        job();
+        loadsInFlight.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+static void queueLoad(std::function<void(void)> job) {
+    loadsInFlight.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        loadJobs.push_back(std::move(job));
+    }
+    loadSignal.notify_one();
+}
+
+// hands a packet to the GL thread, backs off while the queue is full
+static void queueUpload(size_t bytes, std::function<void(void)> upload, std::function<void(void)> finish) {
+    JklUploadPacket* packet = new JklUploadPacket{bytes, std::move(upload), std::move(finish), nullptr};
+    while (!uploads.push(packet))
+        std::this_thread::yield();
+    if (uploadContext)
+        uploadSignal.notify_one();
+}
+
+static void uploaderMain(void) {
+    glfwMakeContextCurrent(uploadContext);
+    while (!uploaderStopping.load(std::memory_order_acquire)) {
+        JklUploadPacket* packet;
+        if (!uploads.pop(packet)) {
+            std::unique_lock<std::mutex> lock(uploadMutex);
+            uploadSignal.wait_for(lock, std::chrono::milliseconds(2));
+            continue;
+        }
+        packet->upload();
+        packet->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // the fence has to reach the GPU before another context can wait on it
+        glFlush();
+        while (!fenced.push(packet))
+            std::this_thread::yield();
+    }
+    glfwMakeContextCurrent(NULL);
+}
+
+// called by every packet of an asset once it's on the GPU, the last one makes the asset resident
+static void finishUpload(JklAsset* asset, size_t bytes) {
+    asset->gpuBytes += bytes;
+    if (asset->pendingUploads.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        asset->state.store(EASSET_RESIDENT, std::memory_order_release);
+        jklReportMemory(asset->path.c_str());
+    }
+}
+
+// registers the asset and queues its first load, the job is kept for reloads after an eviction
+template<typename T>
+static T* track(T* asset, std::function<void(void)> loader) {
+    assets.emplace_back(asset);
+    asset->lastUsedFrame = frameIndex;
+    asset->loader = std::move(loader);
+    queueLoad(asset->loader);
+    return asset;
+}
+
+bool JklAsset::acquire(void) {
+    lastUsedFrame = frameIndex;
+    int evicted = EASSET_EVICTED;
+    if (state.compare_exchange_strong(evicted, EASSET_QUEUED, std::memory_order_acq_rel))
+        queueLoad(loader);
+    return resident();
+}
+
+void JklTextureAsset::evict(void) {
+    jklDeleteTexture(texture);
+    texture = 0;
+    image.release();
+    cooked = JklCookedTexture();
+}
+
+void JklStaticMeshAsset::evict(void) {
+    // the material layers and cell size are set by the caller, not read from the file
+    std::vector<int> layers = std::move(mesh.materialLayers);
+    float cellSize = mesh.cellSize;
+    mesh = StaticMesh();
+    mesh.materialLayers = std::move(layers);
+    mesh.cellSize = cellSize;
+}
+
+void JklModelAsset::evict(void) {
+    model = Model();
+    animation = Animation();
+}
+
+
+void jklstreamStart(int workers, GLFWwindow* context) {
+    if (!loaders.empty())
+        return;
+    uploadContext = context;
+    if (uploadContext) {
+        uploaderStopping.store(false, std::memory_order_relaxed);
+        uploader = std::thread(uploaderMain);
+    }
+    // the cores the job workers leave, decodes run on those workers
+    if (workers <= 0) {
+        int cores = (int)std::thread::hardware_concurrency();
+        workers = std::min(std::max(cores - jkljobWorkerCount(), 1), 4);
+    }
+    stopping = false;
+    for (int i = 0; i < workers; i++)
+        loaders.emplace_back(loaderMain);
+}
+
+void jklstreamStop(void) {
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        stopping = true;
+        loadJobs.clear();
+    }
+    loadSignal.notify_all();
+    for (auto& loader : loaders)
+        loader.join();
+    loaders.clear();
+
+    if (uploadContext) {
+        uploaderStopping.store(true, std::memory_order_release);
+        uploadSignal.notify_all();
+        uploader.join();
+        uploadContext = nullptr;
+    }
+
+    // anything still waiting for upload is dropped with the context
+    JklUploadPacket* packet;
+    while (uploads.pop(packet))
+        delete packet;
+    while (fenced.pop(packet))
+        awaitingFence.push_back(packet);
+    for (JklUploadPacket* waiting : awaitingFence) {
+        glDeleteSync(waiting->fence);
+        delete waiting;
+    }
+    awaitingFence.clear();
+    assets.clear();
+}
+
+
+JklTextureAsset* jklstreamTexture(const char* path, GLint minFilter, GLint magFilter) {
+    JklTextureAsset* asset = new JklTextureAsset(path);
+    asset->minFilter = minFilter;
+    asset->magFilter = magFilter;
+    return track(asset, [asset] {
+        asset->state.store(EASSET_LOADING, std::memory_order_relaxed);
+        asset->gpuBytes = 0;
+        std::string source = asset->path;
+        // cooked textures already carry their mip chain, nothing to decode
+        if (jklIsCookedTexturePath(asset->path.c_str()) && jklReadCookedTexture(asset->path.c_str(), asset->cooked)) {
+            asset->pendingUploads.store(1, std::memory_order_relaxed);
+            asset->state.store(EASSET_UPLOADING, std::memory_order_relaxed);
+            size_t bytes = asset->cooked.data.size();
+            queueUpload(bytes, [asset] {
+                asset->texture = jklUploadCookedTexture(asset->cooked, asset->minFilter, asset->magFilter);
+                asset->cooked = JklCookedTexture();
+            }, [asset, bytes] {
+                finishUpload(asset, bytes);
+            });
+            return;
+        }
+        if (jklIsCookedTexturePath(asset->path.c_str())) {
+            // a broken .jkt still loads when the image it was cooked from is around
+            source = jklCookedTextureSource(asset->path.c_str());
+            if (source.empty()) {
+                asset->state.store(EASSET_FAILED, std::memory_order_release);
+                return;
+            }
+            JKL_WARN(ELOG_ASSET, "loading %s instead of %s", source.c_str(), asset->path.c_str());
+        }
+        if (!jklDecodeImage(source.c_str(), asset->image, -1)) {
+            asset->state.store(EASSET_FAILED, std::memory_order_release);
+            return;
+        }
+        if (jklFilterUsesMips(asset->minFilter))
+            jklBuildMipChain(asset->image);
+        asset->pendingUploads.store(1, std::memory_order_relaxed);
+        asset->state.store(EASSET_UPLOADING, std::memory_order_relaxed);
+        size_t bytes = asset->image.bytes();
+        queueUpload(bytes, [asset] {
+            asset->texture = jklUploadImage(asset->image, asset->minFilter, asset->magFilter);
+            asset->image.release();
+        }, [asset, bytes] {
+            finishUpload(asset, bytes);
+        });
+    });
+}
+
+JklStaticMeshAsset* jklstreamStaticMesh(const char* path, Shader* shader, const std::vector<int>& materialLayers) {
+    JklStaticMeshAsset* asset = new JklStaticMeshAsset(path);
+    asset->shader = shader;
+    asset->mesh.materialLayers = materialLayers;
+    return track(asset, [asset] {
+        asset->state.store(EASSET_LOADING, std::memory_order_relaxed);
+        asset->gpuBytes = 0;
+        if (!asset->mesh.ReadFile(asset->path.c_str())) {
+            asset->state.store(EASSET_FAILED, std::memory_order_release);
+            return;
+        }
+        asset->mesh.BuildCells(asset->path.c_str());
+        asset->pendingUploads.store(1, std::memory_order_relaxed);
+        asset->state.store(EASSET_UPLOADING, std::memory_order_relaxed);
+        size_t bytes = asset->mesh.vertices.size() * sizeof(float);
+        queueUpload(bytes, [asset] {
+            asset->mesh.UploadBuffers();
+        }, [asset, bytes] {
+            asset->mesh.SetupVertexArray(asset->shader);
+            finishUpload(asset, bytes);
+        });
+    });
+}
+
+JklModelAsset* jklstreamModel(const char* path, bool animated) {
+    JklModelAsset* asset = new JklModelAsset(path);
+    asset->animated = animated;
+    return track(asset, [asset] {
+        asset->state.store(EASSET_LOADING, std::memory_order_relaxed);
+        asset->gpuBytes = 0;
+        Model& model = asset->model;
+        model.loadModel(asset->path, false);
+        if (model.meshes.empty()) {
+            asset->state.store(EASSET_FAILED, std::memory_order_release);
+            return;
+        }
+        if (asset->animated)
+            asset->animation = Animation(asset->path, &model);
+
+        // decode every distinct texture once, meshes pick theirs up when it is uploaded. With
+        // jklModelTextureArrays they go into the model's texture arrays, built by a single upload
+        std::vector<std::string> texturePaths;
+        bool arrays = jklModelTextureArrays;
+        size_t arrayBytes = 0;
+        if (arrays) {
+            model.textureArrays.reset(new JklTextureArraySet());
+            model.collectTextures(*model.textureArrays);
+            arrayBytes = model.textureArrays->pendingBytes();
+        }
+        else {
+            for (auto& mesh : model.meshes)
+                if (std::find(texturePaths.begin(), texturePaths.end(), mesh.texturePath) == texturePaths.end())
+                    texturePaths.push_back(mesh.texturePath);
+        }
+
+        int textureUploads = arrays ? 1 : (int)texturePaths.size();
+        asset->pendingUploads.store((int)model.meshes.size() + textureUploads, std::memory_order_relaxed);
+        asset->state.store(EASSET_UPLOADING, std::memory_order_relaxed);
+
+        if (arrays) {
+            queueUpload(arrayBytes, [asset] {
+                asset->model.textureArrays->build();
+            }, [asset, arrayBytes] {
+                asset->model.useTextureArrays(*asset->model.textureArrays);
+                finishUpload(asset, arrayBytes);
+            });
+        }
+
+        // all of a model's textures decode side by side on the decode pool
+        std::vector<std::future<JklImage>> decodes;
+        for (auto& texturePath : texturePaths)
+            decodes.push_back(jklDecodePool().decode(texturePath, -1, true));
+
+        for (size_t t = 0; t < texturePaths.size(); t++) {
+            const std::string& texturePath = texturePaths[t];
+            auto image = std::make_shared<JklImage>(decodes[t].get());
+            auto texture = std::make_shared<Texture>(0);
+            size_t bytes = image->bytes();
+            queueUpload(bytes, [image, texture] {
+                *texture = jklUploadImage(*image);
+            }, [asset, texture, texturePath, bytes] {
+                for (auto& mesh : asset->model.meshes)
+                    if (mesh.texturePath == texturePath)
+                        mesh.textures = *texture;
+                asset->model.textures_loaded.push_back(*texture);
+                asset->model.textures_loaded_paths.push_back(texturePath);
+                finishUpload(asset, bytes);
+            });
+        }
+        for (size_t i = 0; i < model.meshes.size(); i++) {
+            Mesh& mesh = model.meshes[i];
+            size_t bytes = mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+            queueUpload(bytes, [asset, i] {
+                asset->model.meshes[i].uploadBuffers();
+            }, [asset, i, bytes] {
+                asset->model.meshes[i].setupVertexArray();
+                finishUpload(asset, bytes);
+            });
+        }
+    });
+}
+
+
+// with an upload thread the render thread only finishes packets, in order, once their fence signalled
+static void finishFenced(void) {
+    JklUploadPacket* packet;
+    while (fenced.pop(packet))
+        awaitingFence.push_back(packet);
+    while (!awaitingFence.empty()) {
+        packet = awaitingFence.front();
+        GLenum status = glClientWaitSync(packet->fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(packet->fence);
+        packet->finish();
+        delete packet;
+        awaitingFence.pop_front();
+    }
+}
+
+void jklstreamPump(void) {
+    if (uploadContext) {
+        finishFenced();
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    JklUploadPacket* packet;
+    while (uploads.pop(packet)) {
+        packet->upload();
+        packet->finish();
+        bytes += packet->bytes;
+        delete packet;
+
+        if (bytes >= jklStreamBudgetBytes)
+            break;
+        std::chrono::duration<float, std::milli> spent = std::chrono::steady_clock::now() - start;
+        if (spent.count() >= jklStreamBudgetMs)
+            break;
+    }
+}
+
+bool jklstreamIdle(void) {
+    return loadsInFlight.load(std::memory_order_acquire) == 0 && uploads.size() == 0
+        && fenced.size() == 0 && awaitingFence.empty();
+}
+
+size_t jklstreamResidentBytes(void) {
+    size_t bytes = 0;
+    for (auto& asset : assets)
+        if (asset->resident())
+            bytes += asset->gpuBytes;
+    return bytes;
+}
+
+static void evictAsset(JklAsset* asset) {
+    asset->evict();
+    asset->gpuBytes = 0;
+    asset->state.store(EASSET_EVICTED, std::memory_order_release);
+}
+
+void jklstreamEndFrame(void) {
+    size_t bytes = jklstreamResidentBytes();
+    if (bytes > jklGpuBudgetBytes) {
+        std::vector<JklAsset*> candidates;
+        for (auto& asset : assets)
+            if (asset->resident() && asset->lastUsedFrame < frameIndex)
+                candidates.push_back(asset.get());
+        std::sort(candidates.begin(), candidates.end(), [](const JklAsset* a, const JklAsset* b) {
+            return a->lastUsedFrame < b->lastUsedFrame;
+        });
+        for (JklAsset* asset : candidates) {
+            if (bytes <= jklGpuBudgetBytes)
+                break;
+            bytes -= asset->gpuBytes;
+            evictAsset(asset);
+        }
+    }
+    frameIndex++;
+}
+
+bool jklstreamRelease(JklAsset* asset) {
+    if (!asset->resident())
+        return false;
+    evictAsset(asset);
+    return true;
+}
@@ -0,0 +1,344 @@
+#include "include/textures.hpp"
+#include "include/gpuresources.hpp"
+#include "include/memtrack.hpp"
+#include "include/log.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+bool JklPboRing::stage(const void* const* chunks, const size_t* sizes, int count) {
+    if (buffers[0] == 0)
+        glGenBuffers(RING_SIZE, buffers);
+
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+        total += sizes[i];
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[next]);
+    next = (next + 1) % RING_SIZE;
+    // orphan the old storage, the driver hands us fresh memory while the GPU finishes with the old one
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, total, NULL, GL_STREAM_DRAW);
+    unsigned char* dst = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!dst) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        JKL_WARN(ELOG_RENDER, "PBO of %zu bytes could not be mapped, uploading directly", total);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(dst, chunks[i], sizes[i]);
+        dst += sizes[i];
+    }
+    // the store was lost (e.g. a mode switch), the buffer contents are undefined
+    if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        JKL_WARN(ELOG_RENDER, "PBO contents lost on unmap, uploading directly");
+        return false;
+    }
+    return true;
+}
+
+void JklPboRing::unbind(void) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+
+GLenum jklImageFormat(int channels) {
+    switch (channels) {
+        case 1: return GL_RED;
+        case 2: return GL_RG;
+        case 3: return GL_RGB;
+        default: return GL_RGBA;
+    }
+}
+
+bool jklFilterUsesMips(GLint minFilter) {
+    return minFilter == GL_NEAREST_MIPMAP_NEAREST || minFilter == GL_LINEAR_MIPMAP_NEAREST
+        || minFilter == GL_NEAREST_MIPMAP_LINEAR || minFilter == GL_LINEAR_MIPMAP_LINEAR;
+}
+
+bool jklHasS3TC(void) {
+    static int supported = -1;
+    if (supported < 0) {
+        supported = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                supported = 1;
+        }
+    }
+    return supported == 1;
+}
+
+bool jklIsCookedTexturePath(const char* path) {
+    size_t len = strlen(path);
+    return len > 4 && strcmp(path + len - 4, ".jkt") == 0;
+}
+
+bool jklModelTextureArrays = false;
+
+static JklPboRing& threadRing(void) {
+    static thread_local JklPboRing ring;
+    return ring;
+}
+
+static unsigned int createTexture(GLint minFilter, GLint magFilter) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    LastTextureBound = texture;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+    return texture;
+}
+
+unsigned int jklUploadImage(const JklImage& image, GLint minFilter, GLint magFilter) {
+    JklPboRing& ring = threadRing();
+    unsigned int texture = createTexture(minFilter, magFilter);
+    if (!image.data)
+        return texture;
+
+    bool mipmapped = jklFilterUsesMips(minFilter);
+    int levels = mipmapped ? image.levels() : 1;
+
+    std::vector<const void*> chunks(levels);
+    std::vector<size_t> sizes(levels);
+    for (int level = 0; level < levels; level++) {
+        chunks[level] = image.levelData(level);
+        sizes[level] = image.levelBytes(level);
+    }
+    bool staged = ring.stage(chunks.data(), sizes.data(), levels);
+
+    GLenum format = jklImageFormat(image.channels);
+    // rows of 1/3 channel images are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    size_t offset = 0;
+    for (int level = 0; level < levels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, format, image.levelWidth(level), image.levelHeight(level), 0,
+            format, GL_UNSIGNED_BYTE, staged ? (const void*)offset : chunks[level]);
+        offset += sizes[level];
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    ring.unbind();
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    size_t bytes = offset;
+    // no precomputed chain, let the driver build one rather than sample an incomplete texture
+    if (mipmapped && levels == 1 && (image.width > 1 || image.height > 1)) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        bytes = bytes * 4 / 3;
+    }
+    jklGpuRegisterTexture(texture, bytes);
+    return texture;
+}
+
+unsigned int jklUploadCookedTexture(const JklCookedTexture& cooked, GLint minFilter, GLint magFilter) {
+    // the levels are read and expanded by their expected size, a mismatch would run off the data
+    if (!jklValidCookedTexture(cooked)) {
+        JKL_ERROR(ELOG_RENDER, "ERROR::JKT::INVALID_TEXTURE: %ux%u format %u, %d levels", cooked.width, cooked.height, cooked.format, cooked.levels());
+        return 0;
+    }
+    unsigned int texture = createTexture(minFilter, magFilter);
+    int levels = jklFilterUsesMips(minFilter) ? cooked.levels() : 1;
+    if (levels == 0)
+        return texture;
+
+    if (cooked.compressed() && !jklHasS3TC()) {
+        // no hardware decoder, expand the blocks and upload as plain RGBA
+        std::vector<unsigned char> rgba;
+        size_t bytes = 0;
+        for (int level = 0; level < levels; level++) {
+            int w = cooked.levelWidth(level), h = cooked.levelHeight(level);
+            rgba.resize((size_t)w * h * 4);
+            jklDecompressBlocks((EJKT_FORMAT)cooked.format, cooked.levelData(level), w, h, rgba.data());
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+            bytes += rgba.size();
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        jklGpuRegisterTexture(texture, bytes);
+        return texture;
+    }
+
+    JklPboRing& ring = threadRing();
+    std::vector<const void*> chunks(levels);
+    for (int level = 0; level < levels; level++)
+        chunks[level] = cooked.levelData(level);
+    bool staged = ring.stage(chunks.data(), cooked.sizes.data(), levels);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    size_t bytes = 0;
+    for (int level = 0; level < levels; level++) {
+        int w = cooked.levelWidth(level), h = cooked.levelHeight(level);
+        bytes += cooked.sizes[level];
+        const void* offset = staged ? (const void*)(cooked.offsets[level]) : chunks[level];
+        switch (cooked.format) {
+            case EJKT_BC1:
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, w, h, 0, (GLsizei)cooked.sizes[level], offset);
+                break;
+            case EJKT_BC3:
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, w, h, 0, (GLsizei)cooked.sizes[level], offset);
+                break;
+            default: {
+                // EJKT_R8..EJKT_RGBA8 are ordered by channel count
+                GLenum format = jklImageFormat(cooked.format + 1);
+                glTexImage2D(GL_TEXTURE_2D, level, format, w, h, 0, format, GL_UNSIGNED_BYTE, offset);
+            }
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    ring.unbind();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    jklGpuRegisterTexture(texture, bytes);
+    return texture;
+}
+
+unsigned int jklLoadTexture(const char* path, GLint minFilter, GLint magFilter) {
+    JKL_MEM_TAG(EMEM_TEXTURE);
+    std::string source = path;
+    if (jklIsCookedTexturePath(path)) {
+        JklCookedTexture cooked;
+        if (jklReadCookedTexture(path, cooked))
+            return jklUploadCookedTexture(cooked, minFilter, magFilter);
+        // a broken .jkt still loads when the image it was cooked from is around
+        source = jklCookedTextureSource(path);
+        if (source.empty())
+            return 0;
+        JKL_WARN(ELOG_ASSET, "loading %s instead of %s", source.c_str(), path);
+    }
+
+    JklImage image;
+    jklDecodeImage(source.c_str(), image, -1);
+    if (jklFilterUsesMips(minFilter))
+        jklBuildMipChain(image);
+    return jklUploadImage(image, minFilter, magFilter);
+}
+
+
+void JklTextureArraySet::add(const std::string& key, JklImage&& image) {
+    JKL_MEM_TAG(EMEM_TEXTURE);
+    if (contains(key) || !image.data)
+        return;
+
+    int group = -1;
+    for (size_t i = 0; i < groups.size(); i++) {
+        const Group& g = groups[i];
+        if (g.width == image.width && g.height == image.height && g.channels == image.channels && g.layers < MAX_LAYERS) {
+            group = (int)i;
+            break;
+        }
+    }
+    if (group < 0) {
+        groups.push_back(Group{image.width, image.height, image.channels, 0, 0});
+        group = (int)groups.size() - 1;
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.image = std::move(image);
+    entry.group = group;
+    entry.layer = groups[group].layers++;
+    entries.push_back(std::move(entry));
+}
+
+bool JklTextureArraySet::contains(const std::string& key) const {
+    for (const Entry& entry : entries)
+        if (entry.key == key)
+            return true;
+    return false;
+}
+
+size_t JklTextureArraySet::pendingBytes(void) const {
+    size_t bytes = 0;
+    for (const Entry& entry : entries)
+        bytes += entry.image.bytes();
+    return bytes;
+}
+
+void JklTextureArraySet::build(GLint minFilter, GLint magFilter) {
+    JKL_MEM_TAG(EMEM_TEXTURE);
+    JklPboRing& ring = threadRing();
+    bool mipmapped = jklFilterUsesMips(minFilter);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (size_t g = 0; g < groups.size(); g++) {
+        Group& group = groups[g];
+        if (group.array != 0)
+            continue;
+
+        // all layers of an array share one mip count, entries in a group have identical sizes
+        int levels = 1;
+        if (mipmapped) {
+            for (Entry& entry : entries)
+                if (entry.group == (int)g)
+                    jklBuildMipChain(entry.image);
+            for (Entry& entry : entries)
+                if (entry.group == (int)g)
+                    levels = entry.image.levels();
+        }
+
+        GLenum format = jklImageFormat(group.channels);
+        glGenTextures(1, &group.array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, group.array);
+        LastTextureBound = group.array;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, magFilter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        size_t bytes = 0;
+        for (int level = 0; level < levels; level++) {
+            int w = group.width >> level, h = group.height >> level;
+            w = w > 0 ? w : 1;
+            h = h > 0 ? h : 1;
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, w, h, group.layers, 0,
+                format, GL_UNSIGNED_BYTE, NULL);
+            bytes += (size_t)w * h * group.channels * group.layers;
+        }
+        jklGpuRegisterTexture(group.array, bytes);
+
+        // one PBO staging per layer carrying all of its levels
+        std::vector<const void*> chunks(levels);
+        std::vector<size_t> sizes(levels);
+        for (Entry& entry : entries) {
+            if (entry.group != (int)g)
+                continue;
+            for (int level = 0; level < levels; level++) {
+                chunks[level] = entry.image.levelData(level);
+                sizes[level] = entry.image.levelBytes(level);
+            }
+            bool staged = ring.stage(chunks.data(), sizes.data(), levels);
+            size_t offset = 0;
+            for (int level = 0; level < levels; level++) {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, entry.layer,
+                    entry.image.levelWidth(level), entry.image.levelHeight(level), 1,
+                    format, GL_UNSIGNED_BYTE, staged ? (const void*)offset : chunks[level]);
+                offset += sizes[level];
+            }
+            entry.image.release();
+        }
+        ring.unbind();
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+JklTextureArraySet::~JklTextureArraySet(void) {
+    for (Group& group : groups)
+        jklDeleteTexture(group.array);
+}
+
+bool JklTextureArraySet::find(const std::string& key, unsigned int& array, int& layer) const {
+    for (const Entry& entry : entries) {
+        if (entry.key == key) {
+            array = groups[entry.group].array;
+            layer = entry.layer;
+            return array != 0;
+        }
+    }
+    return false;
+}
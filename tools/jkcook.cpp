@@ -0,0 +1,147 @@
+// jkcook : offline asset cooker
+//
+//   jkcook texture <in.png> <out.jkt> [auto|rgba|bc1|bc3] [nomips]
+//   jkcook level <in.jkl> <chunk size>
+//
+// texture decodes the source image, builds the full mip chain and writes a .jkt container the
+// engine uploads without decoding (see include/images.hpp). auto picks BC3 when the image has any
+// transparency and BC1 otherwise, rgba keeps the source channels uncompressed.
+//
+// level sorts the triangles of a .jkl into a grid of chunks by centroid and writes every non
+// empty chunk as its own .jkl, listed in a .jkc next to the source (see include/levelfile.hpp).
+// JklChunkedLevel streams those in and out around the camera.
+
+#include "../include/images.hpp"
+#include "../include/levelfile.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+static bool hasTransparency(const JklImage& image) {
+    if (image.channels != 2 && image.channels != 4)
+        return false;
+    size_t pixels = (size_t)image.width * image.height;
+    for (size_t i = 0; i < pixels; i++)
+        if (image.data[i * image.channels + image.channels - 1] != 255)
+            return true;
+    return false;
+}
+
+static int cookTexture(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "usage: jkcook texture <in.png> <out.jkt> [auto|rgba|bc1|bc3] [nomips]" << std::endl;
+        return 1;
+    }
+    const char* mode = argc > 4 ? argv[4] : "auto";
+    bool mips = !(argc > 5 && strcmp(argv[5], "nomips") == 0);
+
+    JklImage image;
+    if (!jklDecodeImage(argv[2], image))
+        return 1;
+
+    EJKT_FORMAT format;
+    if (strcmp(mode, "rgba") == 0)
+        format = (EJKT_FORMAT)(EJKT_R8 + image.channels - 1);
+    else if (strcmp(mode, "bc1") == 0)
+        format = EJKT_BC1;
+    else if (strcmp(mode, "bc3") == 0)
+        format = EJKT_BC3;
+    else
+        format = hasTransparency(image) ? EJKT_BC3 : EJKT_BC1;
+
+    if (mips)
+        jklBuildMipChain(image);
+
+    JklCookedTexture cooked;
+    jklCookImage(image, format, cooked);
+    if (!jklWriteCookedTexture(argv[3], cooked)) {
+        std::cout << "ERROR::JKCOOK::WRITE_FAILED: " << argv[3] << std::endl;
+        return 1;
+    }
+
+    size_t source = image.bytes();
+    std::cout << argv[2] << " -> " << argv[3] << " : " << image.width << "x" << image.height
+              << ", " << cooked.levels() << " levels, " << cooked.data.size() << " bytes (uncompressed "
+              << source << ")" << std::endl;
+    return 0;
+}
+
+static int cookLevel(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "usage: jkcook level <in.jkl> <chunk size>" << std::endl;
+        return 1;
+    }
+    float chunkSize = (float)atof(argv[3]);
+    if (!(chunkSize > 0.0f)) {
+        std::cout << "ERROR::JKCOOK::BAD_CHUNK_SIZE: " << argv[3] << std::endl;
+        return 1;
+    }
+    JklLevelData level;
+    if (!jklReadLevel(argv[2], level))
+        return 1;
+
+    std::vector<glm::vec3> points;
+    jklLevelPositions(level, points);
+    JklAabb bounds;
+    for (const glm::vec3& point : points)
+        bounds.expand(point);
+
+    // ordered by z, y, x so the chunk list reads like the grid
+    std::map<std::tuple<int, int, int>, std::vector<int>> grid;
+    for (size_t t = 0; t < level.triangles.size(); t++) {
+        glm::vec3 centroid = (points[t * 3] + points[t * 3 + 1] + points[t * 3 + 2]) * (1.0f / 3.0f);
+        glm::vec3 cell = (centroid - bounds.min) * (1.0f / chunkSize);
+        grid[std::make_tuple((int)std::floor(cell.z), (int)std::floor(cell.y), (int)std::floor(cell.x))].push_back((int)t);
+    }
+
+    std::string source(argv[2]);
+    size_t dot = source.find_last_of('.');
+    std::string stem = dot == std::string::npos ? source : source.substr(0, dot);
+    size_t slash = stem.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? stem : stem.substr(slash + 1);
+
+    std::vector<JklLevelChunkInfo> chunks;
+    size_t largest = 0;
+    for (const auto& cell : grid) {
+        JklLevelData chunk;
+        jklExtractLevel(level, cell.second, chunk);
+        std::string file = name + "_" + std::to_string(std::get<2>(cell.first)) + "_" + std::to_string(std::get<1>(cell.first))
+            + "_" + std::to_string(std::get<0>(cell.first)) + ".jkl";
+        std::string path = stem.substr(0, stem.size() - name.size()) + file;
+        if (!jklWriteLevel(path.c_str(), chunk)) {
+            std::cout << "ERROR::JKCOOK::WRITE_FAILED: " << path << std::endl;
+            return 1;
+        }
+        JklLevelChunkInfo info;
+        info.path = file;
+        for (int t : cell.second)
+            for (int v = 0; v < 3; v++)
+                info.bounds.expand(points[t * 3 + v]);
+        chunks.push_back(info);
+        largest = std::max(largest, cell.second.size());
+    }
+
+    std::string list = stem + ".jkc";
+    if (!jklWriteChunkList(list.c_str(), chunks)) {
+        std::cout << "ERROR::JKCOOK::WRITE_FAILED: " << list << std::endl;
+        return 1;
+    }
+    std::cout << argv[2] << " -> " << list << " : " << level.triangles.size() << " triangles in " << chunks.size()
+              << " chunks, largest " << largest << " triangles" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "texture") == 0)
+        return cookTexture(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "level") == 0)
+        return cookLevel(argc, argv);
+
+    std::cout << "usage: jkcook texture <in.png> <out.jkt> [auto|rgba|bc1|bc3] [nomips]" << std::endl;
+    std::cout << "       jkcook level <in.jkl> <chunk size>" << std::endl;
+    return 1;
+}
@@ -0,0 +1,193 @@
+// jkpvs : offline potentially visible set builder
+//
+//   jkpvs <level.jkl> <cell size> [rays per cell pair] [threads]
+//
+// Cuts the level into a grid of cells, sorts its triangles into them the same way the engine
+// does when it loads the level, then decides for every pair of cells whether any triangle of the
+// second can be seen from anywhere inside the first. Each pair is sampled with rays from random
+// points in the first cell to random points on the second cell's triangles, traced against a BVH
+// over every triangle of the level; one unblocked ray is enough. Cells touching each other always
+// see each other. Rows run as jobs on the job system. The result is written next to the level as
+// a .jkv (see include/pvs.hpp).
+//
+// Sampling can miss a visible sliver, more rays per pair make that less likely.
+
+#include "../include/levelfile.hpp"
+#include "../include/pvs.hpp"
+#include "../include/portals.hpp"
+#include "../include/bvh.hpp"
+#include "../include/jobs.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+
+struct PvsJob {
+    std::vector<glm::vec3> points;      // sorted by cell, three per triangle
+    JklCellGraph cells;
+    JklBvh bvh;
+    int rays = 128;
+};
+
+// Moller-Trumbore, t along a normalized direction
+static bool rayTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3* triangle, float& t) {
+    const float epsilon = 1e-7f;
+    glm::vec3 e1 = triangle[1] - triangle[0];
+    glm::vec3 e2 = triangle[2] - triangle[0];
+    glm::vec3 p = glm::cross(direction, e2);
+    float det = glm::dot(e1, p);
+    if (std::fabs(det) < epsilon)
+        return false;
+    float inverse = 1.0f / det;
+    glm::vec3 s = origin - triangle[0];
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    t = glm::dot(e2, q) * inverse;
+    return t > 0.0f;
+}
+
+static bool touching(const JklAabb& a, const JklAabb& b, float slack) {
+    return a.min.x <= b.max.x + slack && b.min.x <= a.max.x + slack
+        && a.min.y <= b.max.y + slack && b.min.y <= a.max.y + slack
+        && a.min.z <= b.max.z + slack && b.min.z <= a.max.z + slack;
+}
+
+static bool cellSeesCell(const PvsJob& job, int from, int to, std::mt19937& random) {
+    const JklCell& source = job.cells.cells[from];
+    const JklCell& target = job.cells.cells[to];
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<int> pick(0, target.count / 3 - 1);
+    glm::vec3 size = source.box.max - source.box.min;
+
+    for (int ray = 0; ray < job.rays; ray++) {
+        glm::vec3 origin = source.box.min + glm::vec3(unit(random), unit(random), unit(random)) * size;
+        const glm::vec3* triangle = &job.points[target.first + pick(random) * 3];
+        float u = unit(random), v = unit(random);
+        if (u + v > 1.0f) {
+            u = 1.0f - u;
+            v = 1.0f - v;
+        }
+        glm::vec3 end = triangle[0] + (triangle[1] - triangle[0]) * u + (triangle[2] - triangle[0]) * v;
+
+        glm::vec3 direction = end - origin;
+        float length = glm::length(direction);
+        if (length < 1e-5f)
+            return true;
+        direction = direction * (1.0f / length);
+        // stop short of the end point so its own triangle doesn't block the ray
+        float distance = length * 0.999f - 1e-4f;
+        int hit = job.bvh.raycast(origin, direction, distance, [&](int object, float& t) {
+            return rayTriangle(origin, direction, &job.points[object * 3], t);
+        });
+        if (hit < 0)
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cout << "usage: jkpvs <level.jkl> <cell size> [rays per cell pair] [threads]" << std::endl;
+        return 1;
+    }
+    float cellSize = (float)atof(argv[2]);
+    if (!(cellSize > 0.0f)) {
+        std::cout << "ERROR::JKPVS::BAD_CELL_SIZE: " << argv[2] << std::endl;
+        return 1;
+    }
+    PvsJob job;
+    if (argc > 3)
+        job.rays = std::max(atoi(argv[3]), 1);
+    int threads = argc > 4 ? atoi(argv[4]) : (int)std::thread::hardware_concurrency();
+    threads = std::max(threads, 1);
+
+    auto start = std::chrono::steady_clock::now();
+    JklLevelData level;
+    if (!jklReadLevel(argv[1], level))
+        return 1;
+    std::vector<glm::vec3> points;
+    jklLevelPositions(level, points);
+    if (points.empty()) {
+        std::cout << "ERROR::JKPVS::EMPTY_LEVEL: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    JklAabb bounds;
+    for (const glm::vec3& point : points)
+        bounds.expand(point);
+    JklPvs pvs;
+    pvs.setGrid(bounds, cellSize);
+    // the engine only takes the .jkv together with this exact .jkl
+    if (!jklLevelFingerprint(argv[1], pvs.levelSize, pvs.levelHash)) {
+        std::cout << "ERROR::JKPVS::LEVEL_NOT_READABLE: " << argv[1] << std::endl;
+        return 1;
+    }
+    const int cellCount = pvs.cellCount();
+
+    // the engine sorts the level into these cells at load time, doing the same here means
+    // every row describes exactly the triangle ranges that will be drawn
+    job.cells.cells.resize(cellCount);
+    for (int c = 0; c < cellCount; c++)
+        job.cells.cells[c].box = pvs.cellBox(c);
+    std::vector<int> order = job.cells.assignTriangles(points.data(), points.size());
+    job.points.reserve(points.size());
+    for (int t : order)
+        job.points.insert(job.points.end(), points.begin() + t * 3, points.begin() + t * 3 + 3);
+
+    std::vector<JklAabb> boxes(order.size());
+    for (size_t t = 0; t < boxes.size(); t++)
+        for (int v = 0; v < 3; v++)
+            boxes[t].expand(job.points[t * 3 + v]);
+    job.bvh.build(boxes);
+
+    int occupied = 0;
+    for (const JklCell& cell : job.cells.cells)
+        occupied += cell.count > 0;
+    std::cout << argv[1] << " : " << order.size() << " triangles, " << pvs.dims[0] << "x" << pvs.dims[1] << "x" << pvs.dims[2]
+              << " cells (" << occupied << " with geometry), " << job.rays << " rays per pair, " << threads << " threads" << std::endl;
+
+    // rows are independent, one job each since their cost varies wildly
+    const size_t rowBytes = pvs.rowBytes();
+    std::vector<uint8_t> bits((size_t)cellCount * rowBytes, 0);
+    jkljobStart(threads - 1);
+    jkljobParallelFor(0, cellCount, 1, [&](int first, int last) {
+        for (int from = first; from < last; from++) {
+            std::mt19937 random(from * 2654435761u + 1);
+            uint8_t* row = &bits[(size_t)from * rowBytes];
+            const JklAabb& box = job.cells.cells[from].box;
+            for (int to = 0; to < cellCount; to++) {
+                const JklCell& target = job.cells.cells[to];
+                // empty cells have nothing to draw
+                if (target.count == 0)
+                    continue;
+                bool visible = to == from || touching(box, target.box, cellSize * 0.01f) || cellSeesCell(job, from, to, random);
+                if (visible)
+                    row[to >> 3] |= (uint8_t)(1 << (to & 7));
+            }
+        }
+    });
+    jkljobStop();
+
+    pvs.compress(bits);
+    std::string out = jklSidecarPath(argv[1], ".jkv");
+    if (!pvs.save(out.c_str())) {
+        std::cout << "ERROR::JKPVS::WRITE_FAILED: " << out << std::endl;
+        return 1;
+    }
+
+    size_t pairs = 0;
+    for (int from = 0; from < cellCount; from++)
+        pairs += pvs.visibleCells(from).size();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "-> " << out << " : " << pvs.compressedBytes() << " bytes (uncompressed " << bits.size() << "), "
+              << (occupied > 0 ? (double)pairs / cellCount : 0.0) << " visible cells per cell, " << seconds << " s" << std::endl;
+    return 0;
+}